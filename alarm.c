@@ -0,0 +1,359 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  alarm.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Sleep until a given time, using the hardware clock's alarm.
+ *
+ *  The DS3231 alarm 1 matches the date, hour, minute and second, so it
+ *  fires exactly at the target, or a whole number of months early, in
+ *  which case it is simply set again.  The PCF8563 alarm only matches
+ *  minutes, so it is set for a minute or two before a distant target, and
+ *  its countdown timer is then set for the last few minutes.  That timer's
+ *  first period is short by up to a second, so the last second is found
+ *  by reading the time.
+ *
+ *  The CPU is halted between checks, to be woken by the next interrupt:
+ *  at worst the vblank, 60 times a second.  On each wake only the INT pin
+ *  is looked at, unless the alarm is nearly due or it is time for one of
+ *  the occasional checks of the flag, which cover a pin that is not wired.
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+
+#include "i2c.h"
+#include "bus.h"
+#include "bcd.h"
+#include "rtc.h"
+#include "cpu.h"
+#include "tick.h"
+#include "alarm.h"
+#include "mos-interface.h"
+
+extern char debug;
+
+static char alarm_pin;			// The pin is believed to be wired
+
+// Registers changed while waiting, and restored afterwards
+static unsigned char saved_ctrl[3];
+static unsigned char saved_alarm[4];
+static unsigned char saved_ddr, saved_alt1, saved_alt2;
+
+static int alarm_addr(char device)
+{
+	return device == 1 ? MOD_RTC_I2C_ADDR : MOD_RTC2_I2C_ADDR;
+}
+
+static unsigned char alarm_reg(char device)
+{
+	return device == 1 ? MOD_RTC_REG_AL_MIN : MOD_RTC2_REG_AL1_SEC;
+}
+
+static int alarm_now(char device, unsigned long *epoch)
+{
+	iso8601_datetime dt;
+
+	if ((device == 1 ? read_modrtc(&dt) : read_modrtc2(&dt)) == -1)
+		return -1;
+
+	*epoch = iso8601_to_epoch(&dt);
+
+	return 0;
+}
+
+static int alarm_pin_low(void)
+{
+	return alarm_pin && (PC_DR & TICK_PIN) == 0;
+}
+
+// Read the alarm and timer flags, clearing any that are set.  Returns 1
+// if one was.
+static int alarm_flag(char device)
+{
+	unsigned char reg, flags, val;
+	int res;
+
+	if (device == 1) {
+		reg = MOD_RTC_REG_CTRL2;
+		flags = MOD_RTC_CTRL2_AF | MOD_RTC_CTRL2_TF;
+	}
+	else {
+		reg = MOD_RTC2_REG_CTRL2;
+		flags = MOD_RTC2_STAT_A1F;
+	}
+
+	bus_open();
+	res = rtc_read_regs(alarm_addr(device), reg, &val, 1);
+	if (res == 0 && (val & flags)) {
+		val &= ~flags;
+		res = rtc_write_regs(alarm_addr(device), reg, &val, 1);
+		if (res == 0)
+			res = 1;
+	}
+	bus_close();
+
+	return res;
+}
+
+/*
+ * alarm_open - save the registers we use, then switch off the PCF8563's
+ * CLKOUT and timer, or the DS3231's square wave, and all alarm interrupts
+ */
+
+static int alarm_open(char device)
+{
+	unsigned char ctrl[3];
+	int addr = alarm_addr(device);
+	int res;
+
+	// GPIO mode 2: input
+	saved_ddr  = PC_DDR & TICK_PIN;
+	saved_alt1 = PC_ALT1 & TICK_PIN;
+	saved_alt2 = PC_ALT2 & TICK_PIN;
+	PC_DDR  |= TICK_PIN;
+	PC_ALT1 &= ~TICK_PIN;
+	PC_ALT2 &= ~TICK_PIN;
+	alarm_pin = 1;
+
+	bus_open();
+	res = rtc_read_regs(addr, alarm_reg(device), saved_alarm,
+			    sizeof saved_alarm);
+	if (res == 0 && device == 1) {
+		res = rtc_read_regs(addr, MOD_RTC_REG_CTRL2, &saved_ctrl[0], 1);
+		if (res == 0)
+			res = rtc_read_regs(addr, MOD_RTC_REG_CLK_CTRL,
+					    &saved_ctrl[1], 2);
+		ctrl[0] = 0;
+		ctrl[1] = 0;
+		if (res == 0)
+			res = rtc_write_regs(addr, MOD_RTC_REG_CTRL2, ctrl, 1);
+		if (res == 0)
+			res = rtc_write_regs(addr, MOD_RTC_REG_CLK_CTRL, ctrl, 2);
+	}
+	else if (res == 0) {
+		res = rtc_read_regs(addr, MOD_RTC2_REG_CTRL, saved_ctrl, 2);
+		ctrl[0] = (saved_ctrl[0] | MOD_RTC2_CTRL_INTCN) &
+			  ~(MOD_RTC2_CTRL_A1IE | MOD_RTC2_CTRL_A2IE);
+		ctrl[1] = saved_ctrl[1] & ~MOD_RTC2_STAT_A1F;
+		if (res == 0)
+			res = rtc_write_regs(addr, MOD_RTC2_REG_CTRL, ctrl, 2);
+	}
+	bus_close();
+
+	return res < 0 ? -1 : 0;
+}
+
+static void alarm_close(char device)
+{
+	unsigned char ctrl;
+	int addr = alarm_addr(device);
+
+	bus_open();
+	rtc_write_regs(addr, alarm_reg(device), saved_alarm,
+		       sizeof saved_alarm);
+	if (device == 1) {
+		rtc_write_regs(addr, MOD_RTC_REG_CLK_CTRL, &saved_ctrl[1], 2);
+		ctrl = saved_ctrl[0] & ~(MOD_RTC_CTRL2_AF | MOD_RTC_CTRL2_TF);
+		rtc_write_regs(addr, MOD_RTC_REG_CTRL2, &ctrl, 1);
+	}
+	else {
+		rtc_write_regs(addr, MOD_RTC2_REG_CTRL, saved_ctrl, 1);
+		if (rtc_read_regs(addr, MOD_RTC2_REG_CTRL2, &ctrl, 1) == 0) {
+			ctrl &= ~MOD_RTC2_STAT_A1F;
+			rtc_write_regs(addr, MOD_RTC2_REG_CTRL2, &ctrl, 1);
+		}
+	}
+	bus_close();
+
+	PC_DDR  = (PC_DDR & ~TICK_PIN) | saved_ddr;
+	PC_ALT1 = (PC_ALT1 & ~TICK_PIN) | saved_alt1;
+	PC_ALT2 = (PC_ALT2 & ~TICK_PIN) | saved_alt2;
+}
+
+// DS3231 alarm 1 at the target's date, hour, minute and second
+static int alarm_set_modrtc2(unsigned long when)
+{
+	iso8601_datetime dt;
+	unsigned char regs[4], ctrl;
+	int res;
+
+	epoch_to_iso8601(when, &dt);
+	regs[0] = binary_to_bcd(dt.sec);
+	regs[1] = binary_to_bcd(dt.min);
+	regs[2] = binary_to_bcd(dt.hour);
+	regs[3] = binary_to_bcd(dt.day);
+
+	bus_open();
+	res = rtc_write_regs(MOD_RTC2_I2C_ADDR, MOD_RTC2_REG_AL1_SEC, regs,
+			     sizeof regs);
+	if (res == 0)
+		res = rtc_read_regs(MOD_RTC2_I2C_ADDR, MOD_RTC2_REG_CTRL,
+				    &ctrl, 1);
+	ctrl |= MOD_RTC2_CTRL_INTCN | MOD_RTC2_CTRL_A1IE;
+	if (res == 0)
+		res = rtc_write_regs(MOD_RTC2_I2C_ADDR, MOD_RTC2_REG_CTRL,
+				     &ctrl, 1);
+	bus_close();
+
+	return res < 0 ? -1 : 0;
+}
+
+// PCF8563 alarm at the start of a minute, matching day, hour and minute
+static int alarm_set_modrtc(unsigned long when)
+{
+	iso8601_datetime dt;
+	unsigned char regs[4], ctrl = MOD_RTC_CTRL2_AIE;
+	int res;
+
+	epoch_to_iso8601(when, &dt);
+	regs[0] = binary_to_bcd(dt.min);
+	regs[1] = binary_to_bcd(dt.hour);
+	regs[2] = binary_to_bcd(dt.day);
+	regs[3] = MOD_RTC_AL_DISABLE;		// Any day of the week
+
+	bus_open();
+	res = rtc_write_regs(MOD_RTC_I2C_ADDR, MOD_RTC_REG_AL_MIN, regs,
+			     sizeof regs);
+	if (res == 0)
+		res = rtc_write_regs(MOD_RTC_I2C_ADDR, MOD_RTC_REG_CTRL2,
+				     &ctrl, 1);
+	bus_close();
+
+	return res < 0 ? -1 : 0;
+}
+
+// PCF8563 countdown timer, from a 1Hz source
+static int alarm_set_timer(unsigned char secs)
+{
+	unsigned char regs[2], ctrl = MOD_RTC_CTRL2_TIE;
+	int res;
+
+	regs[0] = 0;
+	regs[1] = secs;
+
+	bus_open();
+	res = rtc_write_regs(MOD_RTC_I2C_ADDR, MOD_RTC_REG_TIMER_CTRL, regs,
+			     sizeof regs);
+	regs[0] = MOD_RTC_TIMER_TE | MOD_RTC_TIMER_1HZ;
+	if (res == 0)
+		res = rtc_write_regs(MOD_RTC_I2C_ADDR, MOD_RTC_REG_TIMER_CTRL,
+				     regs, 1);
+	if (res == 0)
+		res = rtc_write_regs(MOD_RTC_I2C_ADDR, MOD_RTC_REG_CTRL2,
+				     &ctrl, 1);
+	bus_close();
+
+	return res < 0 ? -1 : 0;
+}
+
+/*
+ * alarm_sleep - halt until the alarm set for second when fires.  Returns
+ * 0 when it has, ALARM_KEY if a key was pressed, or -1 on a bus error.
+ */
+
+static int alarm_sleep(char device, unsigned long when, unsigned long now)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	unsigned long checked, due;
+	int res;
+
+	checked = sysvars->clock;
+	due = checked + (when - now) * 100;
+
+	for (;;) {
+		if (sysvars->keyascii)
+			return ALARM_KEY;
+
+		if (alarm_pin_low() ||
+		    (long)(sysvars->clock - due) >= -ALARM_EARLY_CS ||
+		    sysvars->clock - checked >= ALARM_CHECK_CS) {
+			res = alarm_flag(device);
+			if (res != 0)
+				return res < 0 ? -1 : 0;
+
+			if (alarm_pin_low()) {
+				if (debug)
+					printf("[alarm pin low without the "
+					       "flag, ignoring it]\r\n");
+				alarm_pin = 0;
+			}
+
+			// Correct the due time for MOS clock drift
+			if (sysvars->clock - checked >= ALARM_CHECK_CS) {
+				checked = sysvars->clock;
+				if (alarm_now(device, &now) < 0)
+					return -1;
+				due = checked + (when > now ? when - now : 0) *
+					        100;
+			}
+		}
+
+		cpu_halt();
+	}
+}
+
+/*
+ * alarm_wait_until - sleep until the hardware clock reaches target, in
+ * seconds since the epoch.  Returns 0 then, ALARM_KEY if a key was pressed
+ * first, or -1 on error.
+ */
+
+int alarm_wait_until(char device, unsigned long target)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	unsigned long now, when;
+	int res;
+
+	if (alarm_open(device) < 0)
+		return -1;
+
+	sysvars->keyascii = 0;
+	for (;;) {
+		if (alarm_now(device, &now) < 0) {
+			res = -1;
+			break;
+		}
+		if (now >= target) {
+			res = 0;
+			break;
+		}
+
+		// Capping the wait keeps the due time in range; the alarm
+		// is set again each time it fires early anyway
+		if (target - now > ALARM_MAX_S)
+			when = now + ALARM_MAX_S;
+		else
+			when = target;
+
+		if (device == 2)
+			res = alarm_set_modrtc2(when);
+		else if (when - now > ALARM_TIMER_MAX) {
+			when = (when - ALARM_LEAD_S) / 60 * 60;
+			res = alarm_set_modrtc(when);
+		}
+		else if (when - now > 1) {
+			when -= 1;
+			res = alarm_set_timer(when - now);
+		}
+		else {
+			// The last second: read the time at every wake
+			cpu_halt();
+			if (sysvars->keyascii) {
+				res = ALARM_KEY;
+				break;
+			}
+			continue;
+		}
+		if (res == 0)
+			res = alarm_sleep(device, when, now);
+		if (res != 0)
+			break;
+	}
+	sysvars->keyascii = 0;
+
+	alarm_close(device);
+
+	return res;
+}
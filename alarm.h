@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  alarm.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef ALARM_H_
+#define ALARM_H_
+
+/*
+ * The alarm interrupt, the DS3231 INT/SQW or PCF8563 INT output, is read
+ * on the tick pin, TICK_PIN in tick.h.  The DS3231 shares the pin with its
+ * 1Hz output, and the PCF8563 INT can be wired to the same pin as its
+ * CLKOUT, since both are open drain and CLKOUT is switched off while
+ * waiting.
+ */
+
+// Furthest ahead the alarm is set, seconds, keeping the due time on the
+// MOS clock within the 248 days a signed difference of centiseconds holds
+#define ALARM_MAX_S		(240UL * 86400)
+
+// Before the alarm is due, the flag is read this often in case the pin
+// is not wired, and the due time is corrected for MOS clock drift
+#define ALARM_CHECK_CS		6000
+
+// How early to start reading the flag at every wake
+#define ALARM_EARLY_CS		20
+
+// Longest wait for the MOD-RTC countdown timer, seconds; further off, its
+// minute alarm is set to this much before the target first
+#define ALARM_TIMER_MAX		240
+#define ALARM_LEAD_S		120
+
+// Returned by alarm_wait_until when a key was pressed
+#define ALARM_KEY		1
+
+int alarm_wait_until(char device, unsigned long target);
+
+#endif // ALARM_H_
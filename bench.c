@@ -0,0 +1,320 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  bench.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "i2c.h"
+#include "i2cbb.h"
+#include "bus.h"
+#include "bcd.h"
+#include "rtc.h"
+#include "prt.h"
+#include "bench.h"
+#include "mos-interface.h"
+
+/*
+ * Time count register-addressed reads of 7 bytes (the size of a time read)
+ * from target_addr over one transport.  Timing uses the MOS clock, so the
+ * count needs to be large enough for centisecond resolution to be useful.
+ */
+static int bench_one(const i2c_bus *b, int target_addr, unsigned char reg,
+		     unsigned int count)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	unsigned char buffer[7];
+	unsigned long start, elapsed;
+	unsigned int i, errors;
+
+	if (b->open(bus_speed) < 0) {
+		printf("%s: unable to open bus\r\n", b->name);
+		return -1;
+	}
+
+	errors = 0;
+	start = sysvars->clock;
+	for (i = 0; i < count; ++i) {
+		if (b->write(target_addr, &reg, 1) < 1 ||
+		    b->read(target_addr, buffer, sizeof buffer) < sizeof buffer)
+			++errors;
+		b->stop();
+	}
+	elapsed = sysvars->clock - start;
+
+	b->close();
+
+	// Centiseconds * 10000 / count = microseconds per transaction
+	printf("%s: %u transactions, %u errors, %lu cs, %lu us each\r\n",
+	       b->name, count, errors, elapsed,
+	       elapsed * 10000UL / count);
+
+	return errors ? -1 : 0;
+}
+
+int bench_bus(int target_addr, unsigned char reg, unsigned int count)
+{
+	int res = 0;
+
+	if (count == 0)
+		return -1;
+
+	printf("Bus speed %lu Hz (controller SCL %lu Hz), target %02x\r\n",
+	       bus_speed_hz(bus_speed), bus_scl_hz(bus_speed), target_addr);
+
+	if (bench_one(&i2c_bus_reg, target_addr, reg, count) < 0)
+		res = -1;
+	if (bench_one(&i2c_bus_mos, target_addr, reg, count) < 0)
+		res = -1;
+	printf("bb: SCL %lu Hz reading, %lu Hz acknowledging, %lu Hz "
+	       "writing\r\n",
+	       bus_bb_scl_hz(bus_speed, BB_READ_MEM, BB_READ_CLK),
+	       bus_bb_scl_hz(bus_speed, BB_ACK_MEM, BB_ACK_CLK),
+	       bus_bb_scl_hz(bus_speed, BB_WRITE_MEM, BB_WRITE_CLK));
+	if (bench_one(&i2c_bus_bb, target_addr, reg, count) < 0)
+		res = -1;
+
+	return res;
+}
+
+/*
+ * Soak test: at each bus speed, count time reads and count writes of a
+ * changing pattern to spare alarm registers, each read back and checked,
+ * over the selected transport with no retries.  Every latency is timed
+ * with the PRT count and kept, for the median.
+ */
+
+typedef struct bench_chip {
+	const char	*name;
+	int		addr;
+	unsigned char	time_reg;
+	unsigned char	scratch_reg;	// Alarm registers, restored after
+	unsigned char	scratch_len;
+	unsigned char	scratch_or;	// Keeps the alarm from matching
+} bench_chip;
+
+static const bench_chip bench_chips[2] = {
+	{ "MOD-RTC", MOD_RTC_I2C_ADDR, MOD_RTC_REG_SEC,
+	  MOD_RTC_REG_AL_MIN, 4, MOD_RTC_AL_DISABLE },
+	{ "MOD-RTC2", MOD_RTC2_I2C_ADDR, MOD_RTC2_REG_SEC,
+	  MOD_RTC2_REG_AL2_MIN, 3, 0 },
+};
+
+typedef struct bench_errors {
+	unsigned int	nack;
+	unsigned int	arb;
+	unsigned int	bus;		// Bus errors and timeouts
+	unsigned int	verify;
+} bench_errors;
+
+static unsigned int bench_lat[2][BENCH_SOAK_MAX];	// Read, write
+
+static void bench_error(bench_errors *e, int res)
+{
+	switch (-res) {
+		case I2C_CT_TARG_NACK:
+		case I2C_CR_TARG_NACK:
+		case I2C_CT_DATA_NACK:
+		case I2C_CR_DATA_NACK:
+			++e->nack;
+			break;
+		case I2C_CT_ARB_LOST:
+			++e->arb;
+			break;
+		default:
+			++e->bus;
+			break;
+	}
+}
+
+// Shell sort, for the median
+static void bench_sort(unsigned int *v, unsigned int n)
+{
+	unsigned int gap, i, j, t;
+
+	for (gap = n / 2; gap > 0; gap /= 2)
+		for (i = gap; i < n; ++i) {
+			t = v[i];
+			for (j = i; j >= gap && v[j - gap] > t; j -= gap)
+				v[j] = v[j - gap];
+			v[j] = t;
+		}
+}
+
+static void bench_row(const char *op, unsigned int *lat, unsigned int n)
+{
+	unsigned long total = 0;
+	unsigned int i;
+
+	for (i = 0; i < n; ++i)
+		total += lat[i];
+	bench_sort(lat, n);
+
+	printf("  %-5s %7lu %7lu %7lu %7lu\r\n", op,
+	       total ? (unsigned long)n * PRT_HZ / total : 0UL,
+	       PRT_TICKS_TO_US((unsigned long)lat[0]),
+	       PRT_TICKS_TO_US((unsigned long)lat[n / 2]),
+	       PRT_TICKS_TO_US((unsigned long)lat[n - 1]));
+}
+
+// Alarm register values that change every time and are always valid BCD
+static void bench_pattern(const bench_chip *c, unsigned int i,
+			  unsigned char *p)
+{
+	p[0] = binary_to_bcd(i % 60) | c->scratch_or;
+	p[1] = binary_to_bcd(i % 24) | c->scratch_or;
+	p[2] = binary_to_bcd(i % 28 + 1) | c->scratch_or;
+	p[3] = i % 7 | c->scratch_or;
+}
+
+static const bench_chip *bench_detect(char device)
+{
+	unsigned char reg, val;
+	int i, res;
+
+	if (device != 0)
+		return &bench_chips[device - 1];
+
+	for (i = 0; i < 2; ++i) {
+		reg = bench_chips[i].time_reg;
+		bus_open();
+		res = bus_xfer(bench_chips[i].addr, &reg, 1, &val, 1);
+		bus_close();
+		if (res == 0)
+			return &bench_chips[i];
+	}
+
+	return NULL;
+}
+
+static int bench_speed(const bench_chip *c, unsigned char speed,
+		       unsigned int count, bench_errors *e)
+{
+	unsigned char buf[7], wbuf[5], rbuf[4], reg;
+	unsigned int i;
+	prt_mark m;
+	int res;
+
+	if (bus->open(speed) < 0)
+		return -1;
+
+	for (i = 0; i < count; ++i) {
+		reg = c->time_reg;
+		prt_mark_now(&m);
+		res = bus_xfer_once(c->addr, &reg, 1, buf, sizeof buf);
+		bench_lat[0][i] = (unsigned int)prt_elapsed(&m);
+		if (res < 0)
+			bench_error(e, res);
+
+		wbuf[0] = c->scratch_reg;
+		bench_pattern(c, i, &wbuf[1]);
+		prt_mark_now(&m);
+		res = bus_xfer_once(c->addr, wbuf, 1 + c->scratch_len, NULL, 0);
+		bench_lat[1][i] = (unsigned int)prt_elapsed(&m);
+		if (res < 0) {
+			bench_error(e, res);
+			continue;
+		}
+
+		reg = c->scratch_reg;
+		res = bus_xfer_once(c->addr, &reg, 1, rbuf, c->scratch_len);
+		if (res < 0)
+			bench_error(e, res);
+		else if (memcmp(rbuf, &wbuf[1], c->scratch_len) != 0)
+			++e->verify;
+	}
+
+	bus->close();
+
+	return 0;
+}
+
+int bench_soak(char device, unsigned int count)
+{
+	const bench_chip *c;
+	bench_errors e, total;
+	unsigned char saved[4], stat = 0, flag;
+	unsigned char speed;
+	int res;
+
+	if (count == 0 || count > BENCH_SOAK_MAX) {
+		printf("Count must be 1 to %u\r\n", BENCH_SOAK_MAX);
+		return -1;
+	}
+
+	c = bench_detect(device);
+	if (c == NULL) {
+		printf("No RTC found\r\n");
+		return -1;
+	}
+
+	// Keep the alarm registers, and the DS3231 alarm 2 flag, which a
+	// pattern could set
+	bus_open();
+	res = rtc_read_regs(c->addr, c->scratch_reg, saved, c->scratch_len);
+	if (res == 0 && c->addr == MOD_RTC2_I2C_ADDR)
+		res = rtc_read_regs(c->addr, MOD_RTC2_REG_CTRL2, &stat, 1);
+	bus_close();
+	if (res < 0) {
+		printf("Unable to read %s alarm registers\r\n", c->name);
+		return -1;
+	}
+	flag = stat & MOD_RTC2_STAT_A2F;
+
+	prt_open();
+	memset(&total, 0, sizeof total);
+
+	printf("%s at %02x over %s, %u of each per speed\r\n",
+	       c->name, c->addr, bus->name, count);
+	printf("  Op      Txn/s  Min us  Med us  Max us\r\n");
+	for (speed = 0; speed < I2C_SPEEDS; ++speed) {
+		memset(&e, 0, sizeof e);
+		if (bus == &i2c_bus_bb)
+			printf("%lu Hz (bit-banged SCL %lu to %lu Hz)\r\n",
+			       bus_speed_hz(speed),
+			       bus_bb_scl_hz(speed, BB_WRITE_MEM,
+					     BB_WRITE_CLK),
+			       bus_bb_scl_hz(speed, BB_READ_MEM,
+					     BB_READ_CLK));
+		else
+			printf("%lu Hz (controller SCL %lu Hz)\r\n",
+			       bus_speed_hz(speed), bus_scl_hz(speed));
+		if (bench_speed(c, speed, count, &e) < 0) {
+			printf("  unable to open bus\r\n");
+			++total.bus;
+			continue;
+		}
+		bench_row("read", bench_lat[0], count);
+		bench_row("write", bench_lat[1], count);
+		printf("  %u NACK, %u arbitration, %u bus, %u verify\r\n",
+		       e.nack, e.arb, e.bus, e.verify);
+
+		total.nack += e.nack;
+		total.arb += e.arb;
+		total.bus += e.bus;
+		total.verify += e.verify;
+	}
+
+	bus_open();
+	res = rtc_write_regs(c->addr, c->scratch_reg, saved, c->scratch_len);
+	if (res == 0 && c->addr == MOD_RTC2_I2C_ADDR && !flag &&
+	    rtc_read_regs(c->addr, MOD_RTC2_REG_CTRL2, &stat, 1) == 0) {
+		stat &= ~MOD_RTC2_STAT_A2F;
+		res = rtc_write_regs(c->addr, MOD_RTC2_REG_CTRL2, &stat, 1);
+	}
+	bus_close();
+	if (res < 0)
+		printf("Unable to restore %s alarm registers\r\n", c->name);
+
+	if (total.nack || total.arb || total.bus || total.verify) {
+		printf("FAIL\r\n");
+		return -1;
+	}
+	printf("PASS\r\n");
+
+	return 0;
+}
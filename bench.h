@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  bench.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#define BENCH_DEFAULT_COUNT	500
+
+// Transactions of each kind per speed in the soak test; the latencies of
+// every one are kept for the median
+#define BENCH_SOAK_COUNT	200
+#define BENCH_SOAK_MAX		500
+
+int bench_bus(int target_addr, unsigned char reg, unsigned int count);
+int bench_soak(char device, unsigned int count);
+
+#endif // BENCH_H_
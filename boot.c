@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  boot.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Entry point of the boot variants, which do nothing but set the system
+ *  clock from one hardware clock, for autoexec.txt.  There is no option
+ *  parsing and no printf, and only the one chip's driver is compiled in.
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#include "rtc.h"
+#include "mos-interface.h"
+
+#ifdef HWCLOCK_MODRTC_ONLY
+#define BOOT_READ		read_modrtc
+#define BOOT_ERROR		"hwclock: unable to read MOD-RTC\r\n"
+#else
+#define BOOT_READ		read_modrtc2
+#define BOOT_ERROR		"hwclock: unable to read MOD-RTC2\r\n"
+#endif
+
+// Stands in for printf in the drivers, see config.h
+int hwclock_noprint(const char *fmt, ...)
+{
+	return 0;
+}
+
+int main(int argc, const char * argv[])
+{
+	iso8601_datetime dt;
+
+	if (BOOT_READ(&dt) == -1) {
+		mos_write(BOOT_ERROR, strlen(BOOT_ERROR));
+		return 19;
+	}
+
+	write_sysrtc(&dt);
+
+	return 0;
+}
@@ -0,0 +1,566 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  bus.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+
+#include "config.h"
+#include "strings.h"
+#include "i2c.h"
+#include "i2cbb.h"
+#include "bus.h"
+#include "prt.h"
+#include "prof.h"
+#include "mos-interface.h"
+
+extern char debug;
+
+const i2c_bus *bus = &i2c_bus_reg;
+unsigned char bus_speed = I2C_SPEED_DEFAULT;
+bus_stats bus_recovery;
+
+static const unsigned long bus_speeds_hz[I2C_SPEEDS] =
+	{ 57600, 115200, 230400, 368640 };
+
+/*
+ * Register-level backend: drives I2C_CTL/I2C_DR directly via i2c.c
+ */
+
+// I2C_CCR values (M << 3 | N) for each speed at 18.432MHz
+static const unsigned char reg_ccr[I2C_SPEEDS] =
+	{ 3 << 3 | 3, 3 << 3 | 2, 3 << 3 | 1, 4 << 3 | 0 };
+
+static int reg_open(unsigned char speed)
+{
+	if (speed >= I2C_SPEEDS)
+		return -1;
+
+	i2c_set_ccr(reg_ccr[speed]);
+	return i2c_init(0, 0) == I2C_OK ? 0 : -1;
+}
+
+static void reg_stop(void)
+{
+	// Set STOP condition to release I2C bus
+	i2c_ctrl_stop(1);
+}
+
+static void reg_close(void)
+{
+	// Every transaction ends with STOP, leave the controller enabled
+}
+
+static int reg_reset(void)
+{
+	// i2c_init disables the controller and resets it through I2C_SRR
+	return i2c_init(0, 0) == I2C_OK ? 0 : -1;
+}
+
+/*
+ * The eZ80F92 SCL and SDA pins are dedicated to the controller and cannot
+ * be driven as GPIO, so there is no bus-clear for this backend.
+ */
+
+const i2c_bus i2c_bus_reg = {
+	"reg", reg_open, i2c_ctrl_write, i2c_ctrl_read, reg_stop, reg_close,
+	reg_reset, NULL
+};
+
+#ifndef HWCLOCK_BOOT
+
+/*
+ * MOS backend: uses the MOS I2C API so the controller can be shared with
+ * other resident software.  Every read and write is a complete
+ * transaction, so a register-addressed read is a write then a read with a
+ * STOP in between rather than a repeated START.
+ */
+
+// Largest transfer MOS accepts in one call
+#define MOS_I2C_MAX_LEN		32
+
+static int mosapi_status(UINT8 status)
+{
+	switch (status) {
+		case MOS_I2C_NORESPONSE:
+			return -I2C_CT_TARG_NACK;
+		case MOS_I2C_ARB_LOST:
+			return -I2C_CT_ARB_LOST;
+		default:
+			return -I2C_ERR_BUS;
+	}
+}
+
+static int mosapi_open(unsigned char speed)
+{
+	if (speed >= I2C_SPEEDS)
+		return -1;
+
+	// MOS does not offer the fastest speed
+	if (speed > I2C_SPEED_230400)
+		speed = I2C_SPEED_230400;
+
+	mos_i2c_open(speed);
+	return 0;
+}
+
+static int mosapi_write(int target_addr, unsigned char *buf, unsigned int len)
+{
+	UINT8 status;
+
+	if (len > MOS_I2C_MAX_LEN)
+		return -1;
+
+	status = mos_i2c_write(target_addr, len, buf);
+	if (debug)
+		printf("[mos w %02x:%d=%d]", target_addr, len, status);
+	if (status != MOS_I2C_OK)
+		return mosapi_status(status);
+
+	return len;
+}
+
+static int mosapi_read(int target_addr, unsigned char *buf, unsigned int len)
+{
+	UINT8 status;
+
+	if (len > MOS_I2C_MAX_LEN)
+		return -1;
+
+	status = mos_i2c_read(target_addr, len, buf);
+	if (debug)
+		printf("[mos r %02x:%d=%d]", target_addr, len, status);
+	if (status != MOS_I2C_OK)
+		return mosapi_status(status);
+
+	return len;
+}
+
+static void mosapi_stop(void)
+{
+	// MOS has already sent STOP at the end of each transfer
+}
+
+static void mosapi_close(void)
+{
+	mos_i2c_close();
+	if (debug)
+		printf("\r\n");
+}
+
+static int mosapi_reset(void)
+{
+	mos_i2c_close();
+	return mosapi_open(bus_speed);
+}
+
+const i2c_bus i2c_bus_mos = {
+	"mos", mosapi_open, mosapi_write, mosapi_read, mosapi_stop, mosapi_close,
+	mosapi_reset, NULL
+};
+
+/*
+ * Bit-banged backend: drives two GPIO pins as SCL and SDA through
+ * i2cbb.asm, for a clock wired to the GPIO header rather than the I2C
+ * pins, or while the controller is in use by something else.
+ */
+
+// One -bbpins bit number, after an optional comma
+static int bb_pin(const char **p)
+{
+	if (**p == ',')
+		++*p;
+	if (**p < '0' || **p > '7')
+		return -1;
+
+	return *(*p)++ - '0';
+}
+
+// Select the pins from -bbpins: the port letter then the SCL and SDA bit
+// numbers, "C,2,3" or "C23" for PC2 and PC3
+int bus_bb_pins(const char *pins)
+{
+	unsigned char ddr, mask;
+	int scl, sda;
+
+	if (pins[0] == 'C' || pins[0] == 'c')
+		ddr = BB_PC_DDR;
+	else if (pins[0] == 'D' || pins[0] == 'd')
+		ddr = BB_PD_DDR;
+	else
+		return -1;
+
+	++pins;
+	if ((scl = bb_pin(&pins)) < 0 || (sda = bb_pin(&pins)) < 0 ||
+	    scl == sda || *pins != '\0')
+		return -1;
+
+	mask = 1 << scl | 1 << sda;
+	if (mask & (ddr == BB_PD_DDR ? BB_PD_RESERVED : BB_PC_RESERVED))
+		return -1;
+
+	bb_ddr = ddr;
+	bb_scl = 1 << scl;
+	bb_sda = 1 << sda;
+
+	return 0;
+}
+
+// Cycles per memory access: one, plus the wait states set for the
+// external RAM on CS0 that the code runs from
+static unsigned int bb_mem_cycles(void)
+{
+	return 1 + (CS0_CTL >> 5);
+}
+
+// Cycles of one SCL period on a path through the bit code, with loops
+// passes of the delay in each half
+static unsigned long bb_cycles(unsigned int mem, unsigned int clk,
+			       unsigned char loops)
+{
+	unsigned int m = bb_mem_cycles();
+
+	return (unsigned long)mem * m + clk +
+	       2 * (BB_HALF_MEM * m + BB_HALF_CLK +
+		    (unsigned long)loops * (BB_LOOP_MEM * m + BB_LOOP_CLK));
+}
+
+// Delay loop passes per half bit that keep reading, the fastest path, no
+// faster than the bus speed.  Where the bit code alone is slower, there
+// is nothing to wait and the bus runs as fast as it can.
+static unsigned char bb_loops(unsigned char speed)
+{
+	unsigned long period, least, pass, loops;
+
+	period = prt_cpu_hz() / bus_speeds_hz[speed];
+	least = bb_cycles(BB_READ_MEM, BB_READ_CLK, 0);
+	if (period <= least)
+		return 0;
+
+	pass = 2 * (BB_LOOP_MEM * bb_mem_cycles() + BB_LOOP_CLK);
+	loops = (period - least + pass - 1) / pass;
+
+	return loops > 255 ? 255 : loops;
+}
+
+/*
+ * bus_bb_scl_hz - the SCL rate the bit code achieves at speed on one of
+ * the paths in i2cbb.h, such as BB_READ_MEM and BB_READ_CLK
+ */
+
+unsigned long bus_bb_scl_hz(unsigned char speed, unsigned int mem,
+			    unsigned int clk)
+{
+	if (speed >= I2C_SPEEDS)
+		return 0;
+
+	return prt_cpu_hz() / bb_cycles(mem, clk, bb_loops(speed));
+}
+
+static int bb_open(unsigned char speed)
+{
+	unsigned char pins = bb_scl | bb_sda;
+
+	if (speed >= I2C_SPEEDS)
+		return -1;
+
+	bb_delay = bb_loops(speed);
+
+	// GPIO mode 2 (input) releases the line, mode 1 (output) with the
+	// latch at 0 pulls it low
+	if (bb_ddr == BB_PC_DDR) {
+		PC_DDR  |= pins;
+		PC_ALT1 &= ~pins;
+		PC_ALT2 &= ~pins;
+		PC_DR   &= ~pins;
+	}
+	else {
+		PD_DDR  |= pins;
+		PD_ALT1 &= ~pins;
+		PD_ALT2 &= ~pins;
+		PD_DR   &= ~pins;
+	}
+
+	return 0;
+}
+
+static int bb_error(int res, unsigned char nack)
+{
+	switch (res) {
+		case BB_NACK:
+			return -nack;
+		case BB_ARB_LOST:
+			return -I2C_CT_ARB_LOST;
+		default:
+			return -I2C_ERR_TIMEOUT;
+	}
+}
+
+static int bb_write(int target_addr, unsigned char *buf, unsigned int len)
+{
+	unsigned int i;
+	int res;
+
+	if (target_addr > I2C_MAX_TARGET_7BIT)
+		return -I2C_ERR_INVALID_TARGET_ADDR;
+
+	res = bb_start();
+	if (res == BB_OK)
+		res = bb_write_byte(target_addr << 1);
+	if (res == BB_OK) {
+		for (i = 0; i < len; ++i)
+			if ((res = bb_write_byte(buf[i])) != BB_OK)
+				break;
+		res = res == BB_OK ? len : bb_error(res, I2C_CT_DATA_NACK);
+	}
+	else
+		res = bb_error(res, I2C_CT_TARG_NACK);
+
+	if (debug)
+		printf("[bb w %02x:%d=%d]", target_addr, len, res);
+
+	return res;
+}
+
+static int bb_read(int target_addr, unsigned char *buf, unsigned int len)
+{
+	unsigned int i;
+	int res;
+
+	if (target_addr > I2C_MAX_TARGET_7BIT)
+		return -I2C_ERR_INVALID_TARGET_ADDR;
+
+	// A repeated START when it follows a write
+	res = bb_start();
+	if (res == BB_OK)
+		res = bb_write_byte(target_addr << 1 | 1);
+	if (res == BB_OK) {
+		// Acknowledge every byte but the last
+		for (i = 0; i < len; ++i) {
+			if ((res = bb_read_byte(i + 1 < len)) < 0)
+				break;
+			buf[i] = res;
+		}
+		res = res < 0 ? -I2C_ERR_TIMEOUT : len;
+	}
+	else
+		res = bb_error(res, I2C_CR_TARG_NACK);
+
+	if (debug)
+		printf("[bb r %02x:%d=%d]", target_addr, len, res);
+
+	return res;
+}
+
+static void bb_stop_bus(void)
+{
+	bb_stop();
+}
+
+static void bb_close(void)
+{
+	// Both lines are left released, nothing to do
+	if (debug)
+		printf("\r\n");
+}
+
+static int bb_reset(void)
+{
+	return bb_open(bus_speed);
+}
+
+static int bb_clear_bus(void)
+{
+	return bb_clear() == BB_OK ? 0 : -1;
+}
+
+const i2c_bus i2c_bus_bb = {
+	"bb", bb_open, bb_write, bb_read, bb_stop_bus, bb_close, bb_reset,
+	bb_clear_bus
+};
+
+/*
+ * SCL from the controller at a speed, from the measured system clock.
+ * SCL = system clock / (10 * (M + 1) * 2^N), and the divisors are too
+ * coarse for any plausible crystal error to change which suits a speed,
+ * so reg_ccr stays as it is.
+ */
+
+unsigned long bus_scl_hz(unsigned char speed)
+{
+	unsigned char ccr;
+
+	if (speed >= I2C_SPEEDS)
+		return 0;
+
+	ccr = reg_ccr[speed];
+	return prt_cpu_hz() / ((10UL * ((ccr >> 3) + 1)) << (ccr & 7));
+}
+
+/*
+ * Backend selection
+ */
+
+static const i2c_bus *bus_list[] =
+	{ &i2c_bus_reg, &i2c_bus_mos, &i2c_bus_bb, NULL };
+
+const i2c_bus *bus_find(const char *name)
+{
+	int i;
+
+	for (i = 0; bus_list[i] != NULL; ++i)
+		if (strcasecmp(name, bus_list[i]->name) == 0)
+			return bus_list[i];
+
+	return NULL;
+}
+
+#endif // HWCLOCK_BOOT
+
+unsigned long bus_speed_hz(unsigned char speed)
+{
+	return speed < I2C_SPEEDS ? bus_speeds_hz[speed] : 0;
+}
+
+int bus_open(void)
+{
+	int res;
+
+	PROF_MARK(PROF_OTHER);
+	res = bus->open(bus_speed);
+	PROF_MARK(PROF_OPEN);
+
+	return res;
+}
+
+void bus_close(void)
+{
+	bus->close();
+}
+
+/*
+ * Retry and recovery
+ */
+
+// Write wbuf then, if rlen is non-zero, read into rbuf.  Returns 0 or a
+// negated I2C status.  A bus error is status 0, which cannot be told apart
+// from a zero-length transfer, so both become -I2C_ERR_BUS.
+int bus_xfer_once(int target_addr, unsigned char *wbuf, unsigned int wlen,
+		  unsigned char *rbuf, unsigned int rlen)
+{
+	int res;
+
+	res = bus->write(target_addr, wbuf, wlen);
+	if (res == 0)
+		res = -I2C_ERR_BUS;
+	else if (res > 0 && res < wlen)
+		res = -I2C_CT_DATA_NACK;
+
+	if (res > 0 && rlen > 0) {
+		res = bus->read(target_addr, rbuf, rlen);
+		if (res == 0)
+			res = -I2C_ERR_BUS;
+		else if (res > 0 && res < rlen)
+			res = -I2C_CR_DATA_NACK;
+	}
+
+	bus->stop();
+
+	return res < 0 ? res : 0;
+}
+
+// A NACK means the target is busy or absent and waiting may help, anything
+// else means the controller or bus is in a bad state and needs a reset.
+static int bus_needs_reset(int res)
+{
+	return !(res == -I2C_CT_TARG_NACK || res == -I2C_CR_TARG_NACK ||
+		 res == -I2C_CT_DATA_NACK || res == -I2C_CR_DATA_NACK);
+}
+
+static void bus_recover(int res)
+{
+	if (!bus_needs_reset(res))
+		return;
+
+	++bus_recovery.resets;
+	bus->reset();
+
+	// Arbitration loss or a timeout with nobody else on the bus points
+	// to a target holding SDA low, so clock it out if we can
+	if (bus->clear != NULL &&
+	    (res == -I2C_CT_ARB_LOST || res == -I2C_ERR_TIMEOUT ||
+	     res == -I2C_ERR_BUS)) {
+		++bus_recovery.clears;
+		bus->clear();
+		bus->reset();
+	}
+}
+
+static void bus_backoff(unsigned int attempt)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	unsigned long start = sysvars->clock;
+	unsigned long delay = (unsigned long)BUS_BACKOFF_CS << attempt;
+
+	while (sysvars->clock - start < delay)
+		;
+}
+
+/*
+ * bus_xfer - a complete register-style transaction with bounded retries
+ */
+
+int bus_xfer(int target_addr, unsigned char *wbuf, unsigned int wlen,
+	     unsigned char *rbuf, unsigned int rlen)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	unsigned long start;
+	unsigned int attempt;
+	int res;
+
+	PROF_MARK(PROF_OTHER);
+	res = bus_xfer_once(target_addr, wbuf, wlen, rbuf, rlen);
+	if (res == 0) {
+		PROF_MARK(PROF_XFER);
+		return 0;
+	}
+
+	start = sysvars->clock;
+	for (attempt = 0; attempt < BUS_MAX_RETRIES; ++attempt) {
+		if (debug)
+			printf("<retry %u: %d>", attempt + 1, res);
+		++bus_recovery.retries;
+		bus_recover(res);
+		bus_backoff(attempt);
+
+		res = bus_xfer_once(target_addr, wbuf, wlen, rbuf, rlen);
+		if (res == 0)
+			break;
+	}
+	bus_recovery.recovery_cs += sysvars->clock - start;
+
+	if (res == 0)
+		++bus_recovery.recovered;
+	else
+		++bus_recovery.failed;
+	PROF_MARK(PROF_XFER);
+
+	return res;
+}
+
+#ifndef HWCLOCK_BOOT
+void bus_report(void)
+{
+	if (bus_recovery.retries == 0)
+		return;
+
+	printf("I2C recovery: %u retries, %u resets, %u clears, "
+	       "%u recovered, %u failed, %lu cs\r\n",
+	       bus_recovery.retries, bus_recovery.resets, bus_recovery.clears,
+	       bus_recovery.recovered, bus_recovery.failed,
+	       bus_recovery.recovery_cs);
+}
+#endif // HWCLOCK_BOOT
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  bus.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef BUS_H_
+#define BUS_H_
+
+// Bus speeds, numbered to match the MOS I2C frequency IDs
+#define I2C_SPEED_57600		0
+#define I2C_SPEED_115200	1
+#define I2C_SPEED_230400	2
+#define I2C_SPEED_368640	3
+#define I2C_SPEEDS		4
+
+#define I2C_SPEED_DEFAULT	I2C_SPEED_368640
+
+/*
+ * An I2C transport.  write and read follow the conventions of
+ * i2c_ctrl_write and i2c_ctrl_read: the number of bytes transferred,
+ * or a negated I2C status on failure.  stop ends the current transaction
+ * and close ends the bus session.  reset returns the controller to a known
+ * state, and clear (optional, it needs control of the pins) clocks out a
+ * target that is holding SDA low.
+ */
+typedef struct i2c_bus {
+	const char *name;
+	int (*open)(unsigned char speed);
+	int (*write)(int target_addr, unsigned char *buf, unsigned int len);
+	int (*read)(int target_addr, unsigned char *buf, unsigned int len);
+	void (*stop)(void);
+	void (*close)(void);
+	int (*reset)(void);
+	int (*clear)(void);
+} i2c_bus;
+
+// Retry and recovery
+#define BUS_MAX_RETRIES		4	// Retries after the first attempt
+#define BUS_BACKOFF_CS		2	// First backoff, doubled each retry
+
+typedef struct bus_stats {
+	unsigned int	retries;	// Attempts after the first
+	unsigned int	resets;		// Soft resets of the controller
+	unsigned int	clears;		// Bus-clear sequences
+	unsigned int	recovered;	// Transactions that failed then passed
+	unsigned int	failed;		// Transactions that never passed
+	unsigned long	recovery_cs;	// Time spent recovering
+} bus_stats;
+
+extern bus_stats bus_recovery;
+
+extern const i2c_bus i2c_bus_reg;
+extern const i2c_bus i2c_bus_mos;
+extern const i2c_bus i2c_bus_bb;
+
+// The selected transport and speed
+extern const i2c_bus *bus;
+extern unsigned char bus_speed;
+
+const i2c_bus *bus_find(const char *name);
+int bus_bb_pins(const char *pins);
+unsigned long bus_speed_hz(unsigned char speed);
+unsigned long bus_scl_hz(unsigned char speed);
+unsigned long bus_bb_scl_hz(unsigned char speed, unsigned int mem,
+			    unsigned int clk);
+
+int bus_open(void);
+int bus_xfer(int target_addr, unsigned char *wbuf, unsigned int wlen,
+	     unsigned char *rbuf, unsigned int rlen);
+int bus_xfer_once(int target_addr, unsigned char *wbuf, unsigned int wlen,
+		  unsigned char *rbuf, unsigned int rlen);
+void bus_close(void);
+void bus_report(void);
+
+#endif // BUS_H_
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  config.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Build variants.  hwclock.zdsproj builds the full utility; each of the
+ *  hwboot projects defines HWCLOCK_BOOT to build a hctosys-only image:
+ *
+ *	HWCLOCK_BOOT=1	MOD-RTC		hwboot1.zdsproj
+ *	HWCLOCK_BOOT=2	MOD-RTC2	hwboot2.zdsproj
+ *
+ *  Define HWCLOCK_NO_FAST_READ to read the time through the C I2C state
+ *  machine only, without the assembly fast path in i2cfast.asm.
+ *
+ *  Include after <stdio.h>.
+ */
+
+#ifndef CONFIG_H_
+#define CONFIG_H_
+
+#ifdef HWCLOCK_BOOT
+#if HWCLOCK_BOOT == 1
+#define HWCLOCK_MODRTC_ONLY
+#else
+#define HWCLOCK_MODRTC2_ONLY
+#endif
+
+// Keep the printf library out of the image
+#define HWCLOCK_NO_PRINTF
+#endif
+
+#ifdef HWCLOCK_NO_PRINTF
+int hwclock_noprint(const char *fmt, ...);
+#define printf hwclock_noprint
+#endif
+
+#endif // CONFIG_H_
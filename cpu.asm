@@ -0,0 +1,22 @@
+; SPDX-License-Identifier: GPL-2.0-or-later
+;
+;  cpu.asm
+;
+;  Copyright (C) 2023  Leigh Brown
+;
+
+		segment code
+
+		xdef	_cpu_halt
+
+		.ASSUME	ADL = 1
+
+; void cpu_halt(void)
+;
+; Stop until the next interrupt.  MOS runs with interrupts enabled, and
+; the vblank interrupt alone wakes the CPU 60 times a second.
+;
+_cpu_halt:	halt
+		ret
+
+		end
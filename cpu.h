@@ -0,0 +1,14 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  cpu.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef CPU_H_
+#define CPU_H_
+
+// Stop the CPU until the next interrupt; MOS takes one at every vblank
+void cpu_halt(void);
+
+#endif // CPU_H_
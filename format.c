@@ -0,0 +1,233 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  format.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  strftime-style output.  A pattern is compiled once into a string of
+ *  opcodes, which format_time then runs, writing digits and names straight
+ *  into the buffer without going through printf.
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "strings.h"
+#include "format.h"
+
+// Presets, already compiled
+const unsigned char format_iso[] = {
+	FMT_YEAR, '-', FMT_MON, '-', FMT_DAY, 'T',
+	FMT_HOUR, ':', FMT_MIN, ':', FMT_SEC, FMT_END
+};
+
+const unsigned char format_iso_offset[] = {
+	FMT_YEAR, '-', FMT_MON, '-', FMT_DAY, 'T',
+	FMT_HOUR, ':', FMT_MIN, ':', FMT_SEC, FMT_OFF_COLON, FMT_END
+};
+
+static const unsigned char format_basic[] = {
+	FMT_YEAR, FMT_MON, FMT_DAY, 'T', FMT_HOUR, FMT_MIN, FMT_SEC, FMT_END
+};
+
+static const unsigned char format_epoch[] = {
+	FMT_EPOCH, FMT_END
+};
+
+static const unsigned char format_rfc2822[] = {
+	FMT_WDAY_NAME, ',', ' ', FMT_DAY, ' ', FMT_MON_NAME, ' ', FMT_YEAR, ' ',
+	FMT_HOUR, ':', FMT_MIN, ':', FMT_SEC, ' ', FMT_OFF, FMT_END
+};
+
+typedef struct format_preset {
+	const char		*name;
+	const unsigned char	*ops;
+} format_preset;
+
+static const format_preset format_presets[] = {
+	{ "iso",	format_iso },
+	{ "extended",	format_iso_offset },
+	{ "basic",	format_basic },
+	{ "epoch",	format_epoch },
+	{ "rfc2822",	format_rfc2822 },
+	{ NULL }
+};
+
+static const char wday_names[] = "SunMonTueWedThuFriSat";
+static const char mon_names[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+const unsigned char *format_find(const char *name)
+{
+	int i;
+
+	for (i = 0; format_presets[i].name != NULL; ++i)
+		if (strcasecmp(name, format_presets[i].name) == 0)
+			return format_presets[i].ops;
+
+	return NULL;
+}
+
+/*
+ * format_compile - translate a pattern into opcodes, returning 0, or -1 if
+ * it has an unknown directive or does not fit in len bytes
+ */
+
+int format_compile(const char *pattern, unsigned char *ops, int len)
+{
+	const char *expand;
+	int n = 0;
+	unsigned char op;
+
+	for (; *pattern; ++pattern) {
+		expand = NULL;
+		op = *pattern;
+		if (op < FORMAT_LITERAL)
+			return -1;
+
+		if (op == '%') {
+			switch (*++pattern) {
+				case 'Y': op = FMT_YEAR; break;
+				case 'y': op = FMT_YEAR2; break;
+				case 'm': op = FMT_MON; break;
+				case 'd': op = FMT_DAY; break;
+				case 'H': op = FMT_HOUR; break;
+				case 'M': op = FMT_MIN; break;
+				case 'S': op = FMT_SEC; break;
+				case 's': op = FMT_EPOCH; break;
+				case 'z': op = FMT_OFF; break;
+				case 'a': op = FMT_WDAY_NAME; break;
+				case 'b': op = FMT_MON_NAME; break;
+				case 'j': op = FMT_YDAY; break;
+				case '%': op = '%'; break;
+				case 'F': expand = "%Y-%m-%d"; break;
+				case 'T': expand = "%H:%M:%S"; break;
+				case ':':
+					if (*++pattern != 'z')
+						return -1;
+					op = FMT_OFF_COLON;
+					break;
+				default:
+					return -1;
+			}
+		}
+
+		if (expand != NULL) {
+			if (format_compile(expand, &ops[n], len - n) < 0)
+				return -1;
+			n += strlen((char *)&ops[n]);
+		}
+		else {
+			if (n + 1 >= len)
+				return -1;
+			ops[n++] = op;
+		}
+	}
+
+	ops[n] = FMT_END;
+	return 0;
+}
+
+// Write v as exactly width decimal digits
+static void put_digits(char *p, unsigned long v, int width)
+{
+	while (width-- > 0) {
+		p[width] = '0' + v % 10;
+		v /= 10;
+	}
+}
+
+/*
+ * format_time - run a compiled format over dt, which is offset minutes
+ * ahead of UTC.  Returns the length written, or -1 if buf is too small.
+ */
+
+int format_time(const unsigned char *ops, const iso8601_datetime *dt,
+		int offset, char *buf, int len)
+{
+	char field[FORMAT_MAX_FIELD];
+	iso8601_datetime jan1;
+	unsigned long epoch, v;
+	const char *src;
+	int n = 0, width, off;
+
+	if (len <= 0)
+		return -1;
+
+	for (; *ops != FMT_END; ++ops) {
+		src = field;
+		switch (*ops) {
+			case FMT_YEAR:
+				put_digits(field, dt->year, width = 4);
+				break;
+			case FMT_YEAR2:
+				put_digits(field, dt->year % 100, width = 2);
+				break;
+			case FMT_MON:
+				put_digits(field, dt->mon, width = 2);
+				break;
+			case FMT_DAY:
+				put_digits(field, dt->day, width = 2);
+				break;
+			case FMT_HOUR:
+				put_digits(field, dt->hour, width = 2);
+				break;
+			case FMT_MIN:
+				put_digits(field, dt->min, width = 2);
+				break;
+			case FMT_SEC:
+				put_digits(field, dt->sec, width = 2);
+				break;
+			case FMT_EPOCH:
+				epoch = iso8601_to_epoch(dt) - (long)offset * 60;
+				for (width = 1, v = epoch; v >= 10; v /= 10)
+					++width;
+				put_digits(field, epoch, width);
+				break;
+			case FMT_OFF:
+			case FMT_OFF_COLON:
+				off = offset < 0 ? -offset : offset;
+				field[0] = offset < 0 ? '-' : '+';
+				put_digits(&field[1], off / 60, 2);
+				if (*ops == FMT_OFF) {
+					put_digits(&field[3], off % 60, 2);
+					width = 5;
+				}
+				else {
+					field[3] = ':';
+					put_digits(&field[4], off % 60, 2);
+					width = 6;
+				}
+				break;
+			case FMT_WDAY_NAME:
+				// 1970-01-01 was a Thursday
+				v = (iso8601_to_epoch(dt) / 86400UL + 4) % 7;
+				src = &wday_names[v * 3];
+				width = 3;
+				break;
+			case FMT_MON_NAME:
+				src = &mon_names[(dt->mon - 1) * 3];
+				width = 3;
+				break;
+			case FMT_YDAY:
+				jan1 = *dt;
+				jan1.mon = jan1.day = 1;
+				v = (iso8601_to_epoch(dt) - iso8601_to_epoch(&jan1))
+				    / 86400UL + 1;
+				put_digits(field, v, width = 3);
+				break;
+			default:
+				field[0] = *ops;
+				width = 1;
+				break;
+		}
+
+		if (n + width >= len)
+			return -1;
+		memcpy(&buf[n], src, width);
+		n += width;
+	}
+
+	buf[n] = 0;
+	return n;
+}
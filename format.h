@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  format.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef FORMAT_H_
+#define FORMAT_H_
+
+#include "iso8601.h"
+
+/*
+ * A compiled format is a zero-terminated string of opcodes, where a byte
+ * below FORMAT_LITERAL is a directive and any other byte is output as is.
+ */
+#define FMT_END			0
+#define FMT_YEAR		1	// %Y
+#define FMT_YEAR2		2	// %y
+#define FMT_MON			3	// %m
+#define FMT_DAY			4	// %d
+#define FMT_HOUR		5	// %H
+#define FMT_MIN			6	// %M
+#define FMT_SEC			7	// %S
+#define FMT_EPOCH		8	// %s
+#define FMT_OFF			9	// %z, +hhmm
+#define FMT_OFF_COLON		10	// %:z, +hh:mm
+#define FMT_WDAY_NAME		11	// %a
+#define FMT_MON_NAME		12	// %b
+#define FMT_YDAY		13	// %j
+#define FORMAT_LITERAL		0x20
+
+// Longest compiled format, including the terminator
+#define FORMAT_MAX_OPS		48
+
+// Longest output of any directive (%s)
+#define FORMAT_MAX_FIELD	10
+
+int format_compile(const char *pattern, unsigned char *ops, int len);
+const unsigned char *format_find(const char *name);
+int format_time(const unsigned char *ops, const iso8601_datetime *dt,
+		int offset, char *buf, int len);
+
+extern const unsigned char format_iso[];
+extern const unsigned char format_iso_offset[];
+
+#endif // FORMAT_H_
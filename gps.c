@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  gps.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Set the hardware clock from a GPS receiver on UART1.
+ *
+ *  A receiver sends the RMC and ZDA sentences some time after the second
+ *  they describe has started, typically 100-500ms.  Without PPS the clock
+ *  is written as the sentence's time reaches the next whole second, going
+ *  by its milliseconds, so it runs behind by that delay.  With PPS, the
+ *  following second is written at the next rising edge, which starts a
+ *  whole UTC second whatever the milliseconds were; both chips restart
+ *  their divider chain when the seconds register is written, so the
+ *  clock's seconds then start with the UTC second.
+ *
+ *  The registers are encoded and the bus opened before the wait, so only
+ *  the transfer itself falls after the moment being written.
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+
+#include "i2c.h"
+#include "bus.h"
+#include "rtc.h"
+#include "nmea.h"
+#include "uart.h"
+#include "gps.h"
+#include "mos-interface.h"
+
+extern char debug;
+
+static int gps_pps_level(void)
+{
+	return (PC_DR & GPS_PPS_PIN) != 0;
+}
+
+// Wait for a rising edge on the PPS pin, returning -1 on timeout
+static int gps_wait_pps(void)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	unsigned long start = sysvars->clock;
+
+	while (gps_pps_level())
+		if (sysvars->clock - start > GPS_PPS_TIMEOUT)
+			return -1;
+	while (!gps_pps_level())
+		if (sysvars->clock - start > GPS_PPS_TIMEOUT)
+			return -1;
+
+	return 0;
+}
+
+// Wait for a valid time sentence, returning its type or -1
+static int gps_wait_fix(nmea_parser *p, nmea_time *t)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	unsigned long start = sysvars->clock;
+	int c, type = -1;
+
+	sysvars->keyascii = 0;
+	while (sysvars->keyascii == 0 &&
+	       sysvars->clock - start < GPS_FIX_TIMEOUT) {
+		c = uart_getc();
+		if (c < 0)
+			continue;
+		type = nmea_feed(p, c, t);
+		if (type != NMEA_NONE)
+			break;
+		type = -1;
+	}
+	sysvars->keyascii = 0;
+
+	return type;
+}
+
+/*
+ * gps_set - set the hardware clock from the next valid RMC or ZDA sentence,
+ * aligned to the PPS edge if pps is set
+ */
+
+int gps_set(char device, char pps, unsigned long baud)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	unsigned char regs[RTC_TIME_BUF];
+	unsigned long fixed;
+	nmea_parser p;
+	nmea_time t;
+	iso8601_datetime dt;
+	int type, res;
+
+	if (uart_open(baud) < 0) {
+		printf("Invalid baud rate: %lu\r\n", baud);
+		return -1;
+	}
+
+	if (pps) {
+		// GPIO mode 2: input
+		PC_DDR  |= GPS_PPS_PIN;
+		PC_ALT1 &= ~GPS_PPS_PIN;
+		PC_ALT2 &= ~GPS_PPS_PIN;
+	}
+
+	nmea_init(&p);
+	type = gps_wait_fix(&p, &t);
+	fixed = sysvars->clock;
+	uart_close();
+
+	if (debug)
+		printf("[nmea %lu ok, %lu bad checksum, %lu invalid, "
+		       "%u overruns]\r\n", p.sentences, p.bad_sum,
+		       p.bad_field, uart_overruns());
+
+	if (type < 0) {
+		printf("No valid time from GPS\r\n");
+		return -1;
+	}
+
+	// Every register is written, never a delta, since the seconds
+	// register restarts the divider chain
+	dt = t.dt;
+	if (pps || t.ms != 0)
+		epoch_to_iso8601(iso8601_to_epoch(&dt) + 1, &dt);
+	rtc_time_regs(device, &dt, regs);
+
+	bus_open();
+	if (pps) {
+		if (gps_wait_pps() < 0) {
+			bus_close();
+			printf("No PPS edge from GPS\r\n");
+			return -1;
+		}
+	}
+	else if (t.ms != 0)
+		while (sysvars->clock - fixed < (1000 - t.ms) / 10)
+			;
+	res = bus_xfer(device == 1 ? MOD_RTC_I2C_ADDR : MOD_RTC2_I2C_ADDR,
+		       regs, sizeof regs, NULL, 0);
+	bus_close();
+
+	if (res < 0) {
+		printf("Unable to write date and time to %s (%d)\r\n",
+		       device == 1 ? "MOD-RTC" : "MOD-RTC2", res);
+		return -1;
+	}
+
+	printf("Set from GPS %s%s: ", type == NMEA_RMC ? "RMC" : "ZDA",
+	       pps ? " at PPS" : "");
+	iso8601_display(&dt);
+
+	return 0;
+}
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  gps.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef GPS_H_
+#define GPS_H_
+
+// Usual rate of NMEA receivers
+#define GPS_DEFAULT_BAUD	9600
+
+/*
+ * GPIO pin (Port C, on the Agon GPIO header) wired to the receiver's PPS
+ * output, whose rising edge starts each UTC second.  PC0 and PC1 are the
+ * UART1 pins, and PC5 the 1Hz tick.
+ */
+#define GPS_PPS_PIN		(1 << 4)
+
+// Longest wait for a valid time sentence, centiseconds
+#define GPS_FIX_TIMEOUT		3000
+
+// Longest wait for a PPS edge, centiseconds
+#define GPS_PPS_TIMEOUT		150
+
+int gps_set(char device, char pps, unsigned long baud);
+
+#endif // GPS_H_
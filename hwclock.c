@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  hwclock.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Cached hardware clock reads, interpolated from the MOS centisecond clock.
+ *
+ *  The chip only reports whole seconds, so a read between MOS clock b and c
+ *  showing second s means the edge into s happened in (b - 100, c].  The
+ *  window [edge_lo, edge_hi] holds the possible MOS clock values of the
+ *  edge into ref_epoch, and every later read narrows it.  The current
+ *  second is certain when every edge in the window gives the same answer;
+ *  only when it does not, or the interval has expired, is the chip read
+ *  again.  Reads are therefore only made close to a second boundary, which
+ *  is exactly where they narrow the window the most.
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+
+#include "rtc.h"
+#include "hwclock.h"
+#include "mos-interface.h"
+
+// MOS clock ticks per second
+#define HWCLOCK_TICKS		100
+
+static char hwclock_device;
+static unsigned int hwclock_interval = HWCLOCK_DEFAULT_INTERVAL;
+
+static char valid;
+static unsigned long ref_epoch;		// Second whose edge is in the window
+static unsigned long edge_lo, edge_hi;	// MOS clock window for that edge
+static unsigned long last_read;		// MOS clock of the last chip read
+
+int hwclock_open(char device)
+{
+	if (device != HWCLOCK_MODRTC && device != HWCLOCK_MODRTC2)
+		return -1;
+
+	hwclock_device = device;
+	valid = 0;
+
+	return 0;
+}
+
+void hwclock_set_interval(unsigned int seconds)
+{
+	hwclock_interval = seconds;
+}
+
+void hwclock_invalidate(void)
+{
+	valid = 0;
+}
+
+// Read the chip and narrow the edge window
+static int hwclock_sample(void)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	iso8601_datetime dt;
+	unsigned long before, now, epoch, shift, lo, hi;
+	int res;
+
+	// The chip can have been sampled any time during the read, which
+	// retries can stretch out
+	before = sysvars->clock;
+	if (hwclock_device == HWCLOCK_MODRTC)
+		res = read_modrtc(&dt);
+	else if (hwclock_device == HWCLOCK_MODRTC2)
+		res = read_modrtc2(&dt);
+	else
+		return -1;
+	if (res < 0)
+		return -1;
+
+	now = sysvars->clock;
+	epoch = iso8601_to_epoch(&dt);
+	last_read = now;
+
+	// Window for the edge into this second, moved back to ref_epoch
+	if (valid && epoch >= ref_epoch) {
+		shift = (epoch - ref_epoch) * HWCLOCK_TICKS;
+		lo = before - (HWCLOCK_TICKS - 1) - shift;
+		hi = now - shift;
+		if ((long)(lo - edge_lo) > 0)
+			edge_lo = lo;
+		if ((long)(hi - edge_hi) < 0)
+			edge_hi = hi;
+		if ((long)(edge_hi - edge_lo) >= 0)
+			return 0;
+	}
+
+	// First read, or inconsistent with the window, so start again
+	ref_epoch = epoch;
+	edge_lo = before - (HWCLOCK_TICKS - 1);
+	edge_hi = now;
+	valid = 1;
+
+	return 0;
+}
+
+/*
+ * hwclock_read - return the interpolated time, reading the chip only when
+ * the current second is uncertain or the interval has expired
+ */
+
+int hwclock_read(hwclock_time *t)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	unsigned long now, mid, early, late;
+	int tries;
+
+	for (tries = 0; tries < 2; ++tries) {
+		now = sysvars->clock;
+		if (!valid || now - last_read >=
+			      (unsigned long)hwclock_interval * HWCLOCK_TICKS) {
+			if (hwclock_sample() < 0)
+				return -1;
+			now = sysvars->clock;
+		}
+
+		// Ticks since the edge, for the latest and earliest edge
+		early = (now - edge_hi) / HWCLOCK_TICKS;
+		late  = (now - edge_lo) / HWCLOCK_TICKS;
+		if (early == late || tries == 1)
+			break;
+
+		// Straddling a boundary, so ask the chip
+		if (hwclock_sample() < 0)
+			return -1;
+	}
+
+	mid = edge_lo + (edge_hi - edge_lo) / 2;
+	t->epoch = ref_epoch + (now - mid) / HWCLOCK_TICKS;
+	t->cs = (now - mid) % HWCLOCK_TICKS;
+	t->unc = (edge_hi - edge_lo + 1) / 2;
+
+	return 0;
+}
+
+int hwclock_now(iso8601_datetime *dt)
+{
+	hwclock_time t;
+
+	if (hwclock_read(&t) < 0)
+		return -1;
+
+	epoch_to_iso8601(t.epoch, dt);
+
+	return 0;
+}
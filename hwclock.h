@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  hwclock.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Public API of libhwclock, for MOS programs that want wall time from the
+ *  hardware clock without running hwclock.bin.  Link with libhwclock.lib
+ *  and mos-interface.obj.
+ */
+
+#ifndef HWCLOCK_H_
+#define HWCLOCK_H_
+
+#include "iso8601.h"
+
+// Devices, as selected by -1 and -2
+#define HWCLOCK_MODRTC		1
+#define HWCLOCK_MODRTC2		2
+
+// Default interval between forced reads of the chip, in seconds
+#define HWCLOCK_DEFAULT_INTERVAL	60
+
+typedef struct hwclock_time {
+	unsigned long	epoch;		// Seconds since 1970-01-01T00:00:00
+	unsigned char	cs;		// Centiseconds into that second
+	unsigned char	unc;		// Uncertainty of cs, centiseconds
+} hwclock_time;
+
+int hwclock_open(char device);
+void hwclock_set_interval(unsigned int seconds);
+void hwclock_invalidate(void);
+int hwclock_read(hwclock_time *t);
+int hwclock_now(iso8601_datetime *dt);
+
+#endif // HWCLOCK_H_
@@ -8,12 +8,41 @@
 #include <stdio.h>
 #include <ez80.h>
 
+#include "config.h"
 #include "i2c.h"
 
-extern char debug;
+// Debug output level, shared with the rest of the I2C and RTC code
+char debug;
 
 static unsigned char i2c_state;
 
+// Clock control register value, M = 4 and N = 0 unless changed
+static unsigned char i2c_ccr = 4 << 3 | 0;
+
+void
+i2c_set_ccr(unsigned char ccr)
+{
+	i2c_ccr = ccr;
+}
+
+/*
+ * i2c_wait_iflg - wait for IFLG, giving up if the bus appears stuck
+ */
+
+static int
+i2c_wait_iflg(void)
+{
+	unsigned int n;
+
+	for (n = 0; n < I2C_IFLG_TIMEOUT; ++n)
+		if (I2C_CTL & I2C_CTL_IFLG)
+			return 1;
+
+	if (debug)
+		printf("<timeout>");
+	return 0;
+}
+
 int
 i2c_init(int target_addr, char general_call)
 {
@@ -35,11 +64,11 @@ i2c_init(int target_addr, char general_call)
 	for (i = 0; i < 100; ++i)
 		;
 
-	// Set I2C clock divider (M) to 4 and exponent (N) to 0
+	// Set I2C clock divider (M) and exponent (N), by default 4 and 0
 	// fSAMP =  18.432MHz		fSCLK / 2 ^ N
 	// fSCL  = 368.684kHz		fSCLK / (10 * (M + 1) * 2 ^ N) 
 	// NB: This assumes 18.432MHz system clock
-	I2C_CCR = 4 << 3 | 0;
+	I2C_CCR = i2c_ccr;
 
 	// Set the I2C_SAR and I2C_XSAR registers depending on target address
 	v = (unsigned char)target_addr << 1;
@@ -97,9 +126,8 @@ i2c_ctrl_stop(unsigned char wait)
 
 	if (wait) {
 		// Wait for STOP condition to complete then clear IFLG
-		while (!(I2C_CTL & I2C_CTL_IFLG))
-			;
-		I2C_CTL &= ~I2C_CTL_IFLG;
+		if (i2c_wait_iflg())
+			I2C_CTL &= ~I2C_CTL_IFLG;
 	}
 }
 
@@ -119,8 +147,8 @@ i2c_ctrl_send_addr(int target_addr, char mode)
 	if (mode != I2C_TARGET_WRITE)
 		b |= 1;
 
-	while (!(I2C_CTL & I2C_CTL_IFLG))
-		;
+	if (!i2c_wait_iflg())
+		return I2C_ERR_TIMEOUT;
 
 	sr = I2C_SR;
 	if (!(sr == I2C_START || sr == I2C_REP_START)) {
@@ -148,8 +176,8 @@ i2c_ctrl_send_data(unsigned char b)
 	      i2c_state == I2C_ST_CTRL_DATA_SENT))
 		return I2C_ERR_INVALID_STATE;
 
-	while (!(I2C_CTL & I2C_CTL_IFLG))
-		;
+	if (!i2c_wait_iflg())
+		return I2C_ERR_TIMEOUT;
 
 	sr = I2C_SR;
 	// XXX: If we get NACK then do not send the byte
@@ -183,8 +211,8 @@ i2c_ctrl_req_byte(char last)
 
 	// Wait for I2C interrupt flag to be set to indicate target address
 	// has been sent (or error)
-	while (!(I2C_CTL & I2C_CTL_IFLG))
-		;
+	if (!i2c_wait_iflg())
+		return I2C_ERR_TIMEOUT;
 
 	// Check status register
 	sr = I2C_SR;
@@ -219,8 +247,8 @@ i2c_ctrl_recv_byte(unsigned char *data, char last)
 		return I2C_ERR_INVALID_STATE;
 
 	// Wait for I2C interrupt flag to be set
-	while (!(I2C_CTL & I2C_CTL_IFLG))
-		;
+	if (!i2c_wait_iflg())
+		return I2C_ERR_TIMEOUT;
 
 	// Check status register
 	sr = I2C_SR;
@@ -287,8 +315,8 @@ i2c_ctrl_write(int target_addr, unsigned char *buf, unsigned int len)
 		return -sr;
 
 	// Wait for last data byte to transfer
-	while (!(I2C_CTL & I2C_CTL_IFLG))
-		;
+	if (!i2c_wait_iflg())
+		return -I2C_ERR_TIMEOUT;
 
 	sr = I2C_SR;
 	// XXX: disabled as did not work: I2C_CTL &= ~I2C_CTL_IFLG;
@@ -69,7 +69,13 @@
 #define I2C_OK				0
 #define I2C_ERR_INVALID_STATE		1
 #define I2C_ERR_INVALID_TARGET_ADDR	2
+#define I2C_ERR_TIMEOUT			3
+#define I2C_ERR_BUS			4	// I2C_BUS_ERROR, but non-zero
 
+// Polls of I2C_CTL to wait for IFLG before treating the bus as stuck
+#define I2C_IFLG_TIMEOUT		10000
+
+void i2c_set_ccr(unsigned char ccr);
 int i2c_init(int target_addr, char general_call);
 void i2c_ctrl_start();
 void i2c_ctrl_stop(unsigned char wait);
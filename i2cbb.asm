@@ -0,0 +1,275 @@
+; SPDX-License-Identifier: GPL-2.0-or-later
+;
+;  i2cbb.asm
+;
+;  Copyright (C) 2023  Leigh Brown
+;
+;  Bit-banged I2C controller on two GPIO pins of one port.  The pins are
+;  driven open-drain: each output latch holds 0, and a line is pulled low
+;  by making its pin an output and released by making it an input, so the
+;  pins need pull-ups.  bus.c sets the port, pins and half-bit delay.
+;
+;  The cycle counts in i2cbb.h follow this code, and need counting again
+;  when it changes.
+;
+
+		segment code
+
+		xdef	_bb_start
+		xdef	_bb_stop
+		xdef	_bb_write_byte
+		xdef	_bb_read_byte
+		xdef	_bb_clear
+		xdef	_bb_ddr
+		xdef	_bb_scl
+		xdef	_bb_sda
+		xdef	_bb_delay
+
+		.ASSUME	ADL = 1
+
+; As in i2cbb.h
+BB_OK:		equ	0
+BB_NACK:	equ	1
+BB_ARB_LOST:	equ	2
+BB_TIMEOUT:	equ	3
+
+; Polls of SCL while a target stretches the clock
+BB_STRETCH:	equ	256
+
+; int bb_start(void)
+;
+; START, or a repeated START when SCL is low after a byte.  Fails with
+; BB_ARB_LOST if SDA is held low, or BB_TIMEOUT if SCL is.
+;
+_bb_start:	call	sda_high
+		call	bb_half
+		call	scl_high
+		jp	c,timeout
+		call	bb_half
+		call	sda_read
+		jp	z,arb_lost
+		call	sda_low
+		call	bb_half
+		call	scl_low
+		ld	hl,BB_OK
+		ret
+
+; int bb_stop(void)
+;
+; STOP, from SCL low after a byte, leaving both lines released.
+;
+_bb_stop:	call	sda_low
+		call	bb_half
+		call	scl_high
+		jp	c,timeout
+		call	bb_half
+		call	sda_high
+		call	bb_half
+		call	sda_read
+		jp	z,arb_lost
+		ld	hl,BB_OK
+		ret
+
+; int bb_write_byte(unsigned char b)
+;
+; Send b, most significant bit first, and clock in the acknowledge.
+; Returns BB_OK, BB_NACK, or BB_ARB_LOST if a released 1 bit reads back
+; low.  Uses D for the byte and E for the bit count.
+;
+_bb_write_byte:	ld	hl,3
+		add	hl,sp
+		ld	d,(hl)
+		ld	e,8
+wbit:		bit	7,d
+		jr	z,$F
+		call	sda_high
+		jr	wclk
+$$:		call	sda_low
+wclk:		call	bb_half
+		call	scl_high
+		jp	c,timeout
+		bit	7,d
+		jr	z,$F
+		call	sda_read
+		jp	z,arb_lost
+$$:		call	bb_half
+		call	scl_low
+		sla	d
+		dec	e
+		jr	nz,wbit
+
+		call	sda_high		; The target drives the acknowledge
+		call	bb_half
+		call	scl_high
+		jp	c,timeout
+		call	sda_read
+		ld	e,a
+		call	bb_half
+		call	scl_low
+		ld	hl,BB_OK
+		ld	a,e
+		or	a,a
+		ret	z
+		ld	hl,BB_NACK
+		ret
+
+; int bb_read_byte(char ack)
+;
+; Clock in a byte, then acknowledge it if ack is non-zero.  Returns the
+; byte, or -1 if a target held SCL low for too long.
+;
+_bb_read_byte:	ld	hl,3
+		add	hl,sp
+		ld	a,(hl)
+		push	af
+		call	sda_high
+		ld	d,0
+		ld	e,8
+rbit:		call	bb_half
+		call	scl_high
+		jr	c,rtimeout
+		call	sda_read
+		sla	d
+		or	a,a
+		jr	z,$F
+		inc	d
+$$:		call	bb_half
+		call	scl_low
+		dec	e
+		jr	nz,rbit
+
+		pop	af
+		or	a,a
+		jr	z,$F			; Leave SDA released to NACK
+		call	sda_low
+$$:		call	bb_half
+		call	scl_high
+		jr	c,rfail
+		call	bb_half
+		call	scl_low
+		call	sda_high
+		ld	hl,0
+		ld	l,d
+		ret
+
+rtimeout:	pop	af
+rfail:		call	sda_high
+		ld	hl,-1
+		ret
+
+; int bb_clear(void)
+;
+; Nine clocks with SDA released, so a target part way through sending a
+; byte finishes it and lets go of SDA, then STOP.
+;
+_bb_clear:	call	sda_high
+		ld	e,9
+clk:		call	scl_low
+		call	bb_half
+		call	scl_high
+		jp	c,timeout
+		call	bb_half
+		dec	e
+		jr	nz,clk
+		call	scl_low
+		call	bb_half
+		jp	_bb_stop
+
+arb_lost:	call	sda_high
+		ld	hl,BB_ARB_LOST
+		ret
+
+timeout:	call	sda_high
+		ld	hl,BB_TIMEOUT
+		ret
+
+; Wait _bb_delay passes of BB_LOOP_MEM memory accesses and BB_LOOP_CLK
+; more cycles each.  Uses A.
+;
+bb_half:	ld	a,(_bb_delay)
+		or	a,a
+		ret	z
+$$:		dec	a
+		jr	nz,$B
+		ret
+
+; Point BC at the DDR register.  IN and OUT with (C) put B on the upper
+; address lines, so it must be zero.
+;
+ddr:		ld	bc,0
+		ld	a,(_bb_ddr)
+		ld	c,a
+		ret
+
+; Drive SDA low.  Uses A, BC and L.
+;
+sda_low:	call	ddr
+		ld	a,(_bb_sda)
+		cpl
+		ld	l,a
+		in	a,(c)
+		and	a,l
+		out	(c),a
+		ret
+
+; Release SDA.  Uses A, BC and L.
+;
+sda_high:	call	ddr
+		ld	a,(_bb_sda)
+		ld	l,a
+		in	a,(c)
+		or	a,l
+		out	(c),a
+		ret
+
+; Read SDA: Z if it is low.  The data register is just below DDR.  Uses
+; A, BC and HL.
+;
+sda_read:	call	ddr
+		dec	c
+		in	a,(c)
+		ld	hl,_bb_sda
+		and	a,(hl)
+		ret
+
+; Drive SCL low.  Uses A, BC and L.
+;
+scl_low:	call	ddr
+		ld	a,(_bb_scl)
+		cpl
+		ld	l,a
+		in	a,(c)
+		and	a,l
+		out	(c),a
+		ret
+
+; Release SCL and wait for it to go high, allowing a target to stretch
+; the clock.  Returns with carry set if it stays low.  Uses A, BC and HL.
+;
+scl_high:	call	ddr
+		ld	a,(_bb_scl)
+		ld	l,a
+		in	a,(c)
+		or	a,l
+		out	(c),a
+		dec	c
+		ld	h,BB_STRETCH & 0FFh
+$$:		in	a,(c)
+		and	a,l
+		ret	nz			; AND clears carry
+		dec	h
+		jr	nz,$B
+		scf
+		ret
+
+		segment data
+
+; I/O address of the port's DDR register, and the pin masks: PC2 and PC3
+_bb_ddr:	db	9Fh
+_bb_scl:	db	04h
+_bb_sda:	db	08h
+
+; Half-bit delay loop count, from the bus speed
+_bb_delay:	db	0
+
+		end
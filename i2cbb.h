@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  i2cbb.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef I2CBB_H_
+#define I2CBB_H_
+
+// I/O addresses of the DDR registers of the ports on the GPIO header
+#define BB_PC_DDR		0x9F
+#define BB_PD_DDR		0xA3
+
+// Port D pins 0-3 carry UART0 to the VDP
+#define BB_PD_RESERVED		0x0f
+
+// Port C pins 0-1 carry UART1 for -gps, 4 the PPS input and 5 the 1Hz tick
+#define BB_PC_RESERVED		0x33
+
+/*
+ * Cycles of one SCL period on each path through the bit code, counted from
+ * the eZ80 ADL instruction tables, leaving out the two calls to bb_half.
+ * _MEM is memory accesses (instruction bytes, data and the stack), each
+ * taking one cycle plus the wait states of the RAM the code runs from;
+ * _CLK is the rest (on-chip I/O, and taken jumps, calls and returns).
+ * Writing a 1 is the slowest path, since the bit is read back to detect
+ * arbitration loss, and reading a bit the fastest.
+ */
+#define BB_WRITE_MEM		200
+#define BB_WRITE_CLK		26
+#define BB_READ_MEM		145
+#define BB_READ_CLK		19
+#define BB_ACK_MEM		187	// Clocking in the ACK after a write
+#define BB_ACK_CLK		24
+
+// bb_half itself, and each pass of its delay loop
+#define BB_HALF_MEM		18
+#define BB_HALF_CLK		1
+#define BB_LOOP_MEM		3
+#define BB_LOOP_CLK		1
+
+// Results of the bit-level routines
+#define BB_OK			0
+#define BB_NACK			1
+#define BB_ARB_LOST		2
+#define BB_TIMEOUT		3
+
+// Set before use, defaults PC2 (SCL) and PC3 (SDA)
+extern unsigned char bb_ddr;
+extern unsigned char bb_scl;
+extern unsigned char bb_sda;
+extern unsigned char bb_delay;
+
+int bb_start(void);
+int bb_stop(void);
+int bb_write_byte(unsigned char b);
+int bb_read_byte(char ack);
+int bb_clear(void);
+
+#endif // I2CBB_H_
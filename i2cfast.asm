@@ -0,0 +1,243 @@
+; SPDX-License-Identifier: GPL-2.0-or-later
+;
+;  i2cfast.asm
+;
+;  Copyright (C) 2023  Leigh Brown
+;
+;  The whole register-addressed time read on the eZ80F92 I2C controller,
+;  with no state variables or debug checks between the bus events.  The
+;  controller must already be initialised by bus_open().
+;
+
+		segment code
+
+		xdef	_i2c_fast_read_time
+
+		.ASSUME	ADL = 1
+
+; eZ80F92 I2C registers
+I2C_DR:		equ	0CAh
+I2C_CTL:	equ	0CBh
+I2C_SR:		equ	0CCh
+
+; I2C_CTL bits
+CTL_ENAB:	equ	40h
+CTL_STA:	equ	20h
+CTL_STP:	equ	10h
+CTL_IFLG:	equ	08h
+CTL_AAK:	equ	04h
+
+; I2C_SR values along the way
+SR_START:	equ	08h
+SR_REP_START:	equ	10h
+SR_CT_TARG_ACK:	equ	18h
+SR_CT_DATA_ACK:	equ	28h
+SR_CR_TARG_ACK:	equ	40h
+SR_CR_DATA_ACK:	equ	50h
+SR_CR_DATA_NACK: equ	58h
+
+; As I2C_ERR_TIMEOUT, I2C_ERR_BUS and I2C_IFLG_TIMEOUT in i2c.h
+ERR_TIMEOUT:	equ	3
+ERR_BUS:	equ	4
+IFLG_TIMEOUT:	equ	10000
+
+; Seconds to years, on both chips
+TIME_REGS:	equ	7
+
+; Offsets into iso8601_datetime
+DT_YEAR:	equ	0
+DT_MON:		equ	2
+DT_DAY:		equ	3
+DT_HOUR:	equ	4
+DT_MIN:		equ	5
+DT_SEC:		equ	6
+
+; int i2c_fast_read_time(int target_addr, unsigned char reg, char device,
+;			 iso8601_datetime *dt)
+;
+; Write the register address, then read the seven time registers after a
+; repeated START and decode them into dt.  device is 1 for the MOD-RTC,
+; which has the day before the weekday, or 2 for the MOD-RTC2.
+;
+; Returns 0, or the unexpected I2C_SR status (ERR_BUS for a bus error,
+; ERR_TIMEOUT if IFLG never came) after sending STOP.  dt is only written
+; on success.
+;
+_i2c_fast_read_time:
+		push	ix
+		ld	ix,0
+		add	ix,sp
+
+		ld	a,(ix+6)		; Target address, write
+		add	a,a
+		ld	e,a
+
+		ld	a,CTL_ENAB | CTL_STA
+		out0	(I2C_CTL),a
+		call	wait_iflg
+		cp	a,SR_START
+		jr	z,$F
+		cp	a,SR_REP_START
+		jp	nz,fail
+
+$$:		ld	a,e
+		out0	(I2C_DR),a
+		ld	a,CTL_ENAB
+		out0	(I2C_CTL),a
+		call	wait_iflg
+		cp	a,SR_CT_TARG_ACK
+		jp	nz,fail
+
+		ld	a,(ix+9)		; Register address
+		out0	(I2C_DR),a
+		ld	a,CTL_ENAB
+		out0	(I2C_CTL),a
+		call	wait_iflg
+		cp	a,SR_CT_DATA_ACK
+		jp	nz,fail
+
+		ld	a,CTL_ENAB | CTL_STA	; Repeated START
+		out0	(I2C_CTL),a
+		call	wait_iflg
+		cp	a,SR_REP_START
+		jp	nz,fail
+
+		ld	a,e			; Target address, read
+		or	a,1
+		out0	(I2C_DR),a
+		ld	a,CTL_ENAB
+		out0	(I2C_CTL),a
+		call	wait_iflg
+		cp	a,SR_CR_TARG_ACK
+		jp	nz,fail
+
+		; Acknowledge every byte but the last
+		ld	hl,time_buf
+		ld	d,TIME_REGS
+recv:		dec	d
+		ld	a,CTL_ENAB | CTL_AAK
+		jr	nz,$F
+		ld	a,CTL_ENAB
+$$:		out0	(I2C_CTL),a
+		call	wait_iflg
+		cp	a,SR_CR_DATA_ACK
+		jr	z,$F
+		cp	a,SR_CR_DATA_NACK
+		jp	nz,fail
+$$:		in0	a,(I2C_DR)
+		ld	(hl),a
+		inc	hl
+		ld	a,d
+		or	a,a
+		jr	nz,recv
+
+		call	stop
+
+		; Decode
+		push	iy
+		ld	iy,(ix+15)
+		ld	hl,time_buf
+		ld	a,(hl)			; Seconds
+		and	a,7Fh
+		call	bcd_to_bin
+		ld	(iy+DT_SEC),a
+		inc	hl
+		ld	a,(hl)			; Minutes
+		and	a,7Fh
+		call	bcd_to_bin
+		ld	(iy+DT_MIN),a
+		inc	hl
+		ld	a,(hl)			; Hours
+		and	a,3Fh
+		call	bcd_to_bin
+		ld	(iy+DT_HOUR),a
+		inc	hl
+		ld	a,(ix+12)
+		cp	a,1
+		jr	z,$F
+		inc	hl			; The MOD-RTC2 has the weekday first
+$$:		ld	a,(hl)			; Day
+		and	a,3Fh
+		call	bcd_to_bin
+		ld	(iy+DT_DAY),a
+		ld	hl,time_buf+5
+		ld	a,(hl)			; Month, without the century bit
+		and	a,1Fh
+		call	bcd_to_bin
+		ld	(iy+DT_MON),a
+		inc	hl
+		ld	a,(hl)			; Year
+		call	bcd_to_bin
+		ld	de,0
+		ld	e,a
+		ld	hl,2000
+		add	hl,de
+		ld	(iy+DT_YEAR),l
+		ld	(iy+DT_YEAR+1),h
+		pop	iy
+
+		ld	hl,0
+		pop	ix
+		ret
+
+fail:		or	a,a
+		jr	nz,$F
+		ld	a,ERR_BUS
+$$:		push	af
+		call	stop
+		pop	af
+		ld	hl,0
+		ld	l,a
+		pop	ix
+		ret
+
+; Wait for IFLG and return I2C_SR in A, or ERR_TIMEOUT, which is not a
+; status the controller ever reports.  Uses BC.
+;
+wait_iflg:	ld	bc,IFLG_TIMEOUT
+$$:		in0	a,(I2C_CTL)
+		and	a,CTL_IFLG
+		jr	nz,$F
+		dec	bc
+		ld	a,c
+		or	a,b
+		jr	nz,$B
+		ld	a,ERR_TIMEOUT
+		ret
+$$:		in0	a,(I2C_SR)
+		ret
+
+; Send STOP and wait for the controller to clear STP.  Uses A and BC.
+;
+stop:		ld	a,CTL_ENAB | CTL_STP
+		out0	(I2C_CTL),a
+		ld	bc,IFLG_TIMEOUT
+$$:		in0	a,(I2C_CTL)
+		and	a,CTL_STP
+		ret	z
+		dec	bc
+		ld	a,c
+		or	a,b
+		jr	nz,$B
+		ret
+
+; Convert the BCD byte in A to binary.  Uses DE.
+;
+bcd_to_bin:	ld	d,a
+		and	a,0F0h
+		rrca
+		ld	e,a			; Tens * 8
+		rrca
+		rrca
+		add	a,e			; Tens * 10
+		ld	e,a
+		ld	a,d
+		and	a,0Fh
+		add	a,e
+		ret
+
+		segment data
+
+time_buf:	blkb	TIME_REGS, 0
+
+		end
@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  i2cfast.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef I2CFAST_H_
+#define I2CFAST_H_
+
+#include "iso8601.h"
+
+/*
+ * Read and decode the seven time registers starting at reg, in assembly,
+ * on the eZ80F92 controller.  device is 1 for the MOD-RTC, 2 for the
+ * MOD-RTC2.  Returns 0, or the I2C status that stopped the transfer.
+ */
+int i2c_fast_read_time(int target_addr, unsigned char reg, char device,
+		       iso8601_datetime *dt);
+
+#endif // I2CFAST_H_
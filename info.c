@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  info.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Report the size of this image, from symbols defined in hwclock.linkcmd,
+ *  and the size and load time of each build variant found in /mos.
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "info.h"
+#include "mos-interface.h"
+
+// Linker symbols; the lengths are values, not addresses
+extern char _low_image[], _high_image[];
+extern char _low_bss[], _len_bss[], _high_ram[];
+
+static const char *info_variants[] = {
+	"hwclock",	// Full utility
+	"hwboot1",	// -hctosys for MOD-RTC
+	"hwboot2",	// -hctosys for MOD-RTC2
+	NULL
+};
+
+/*
+ * info_load - time reading a file from the SD card the way MOS loads it,
+ * returning its length, or -1 if it does not exist
+ */
+
+static long info_load(const char *name, unsigned long *cs)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	static char buf[INFO_CHUNK];
+	char path[sizeof INFO_DIR + 8 + sizeof INFO_EXT];
+	unsigned long start;
+	long len = 0;
+	unsigned int n;
+	UINT8 fh;
+
+	strcpy(path, INFO_DIR);
+	strcat(path, name);
+	strcat(path, INFO_EXT);
+
+	start = sysvars->clock;
+	fh = mos_fopen(path, fa_read | fa_open_existing);
+	if (fh == 0)
+		return -1;
+	do {
+		n = mos_fread(fh, buf, sizeof buf);
+		len += n;
+	} while (n == sizeof buf);
+	mos_fclose(fh);
+	*cs = sysvars->clock - start;
+
+	return len;
+}
+
+int info_show(void)
+{
+	unsigned long image = _high_image - _low_image + 1;
+	unsigned long bss = (unsigned long)_len_bss;
+	unsigned long top = (unsigned long)_low_bss + bss;
+	unsigned long cs;
+	long len;
+	int i;
+
+	printf("Image:  %lu bytes at %06lX\r\n", image,
+	       (unsigned long)_low_image);
+	printf("BSS:    %lu bytes, %lu bytes free below %06lX\r\n", bss,
+	       (unsigned long)_high_ram - top + 1, (unsigned long)_high_ram);
+
+	for (i = 0; info_variants[i] != NULL; ++i) {
+		len = info_load(info_variants[i], &cs);
+		if (len < 0)
+			continue;
+		printf("%s%s: %ld bytes, loads in %lu.%02lu s\r\n",
+		       info_variants[i], INFO_EXT, len, cs / 100, cs % 100);
+	}
+
+	return 0;
+}
@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  info.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef INFO_H_
+#define INFO_H_
+
+// Where MOS keeps the binaries, and the name of each build variant
+#define INFO_DIR		"/mos/"
+#define INFO_EXT		".bin"
+
+// Chunk read at a time when timing a load
+#define INFO_CHUNK		256
+
+int info_show(void);
+
+#endif // INFO_H_
@@ -12,6 +12,14 @@
 
 		xref	_main
 
+	IFDEF HWCLOCK_PROFILE
+		xref	_prt_start
+		xref	_prof_mark
+
+PROF_BSS:	equ	0			; Phases, as in prof.h
+PROF_PARAMS:	equ	1
+	ENDIF
+
 		.ASSUME	ADL = 1	
 
 argv_ptrs_max:	equ	16			; Size of argv array
@@ -40,9 +48,22 @@ _start:		; Save registers for returning to MOS, including MB
 		xor 	a
 		ld 	mb,a
 
+	IFDEF HWCLOCK_PROFILE
+		; Start the profiling count, saving HL as below
+		push	hl
+		call	_prt_start
+		pop	hl
+	ENDIF
+
 		; Clear BSS, saving HL which contains address of argument string
 		push	hl
 		call	clear_bss
+	IFDEF HWCLOCK_PROFILE
+		ld	bc,PROF_BSS
+		push	bc
+		call	_prof_mark
+		pop	bc
+	ENDIF
 		pop	hl
 
 		; Push argv onto stack, then parse parameters into it
@@ -54,6 +75,13 @@ _start:		; Save registers for returning to MOS, including MB
 		ld	b,0
 		push	bc
 
+	IFDEF HWCLOCK_PROFILE
+		ld	bc,PROF_PARAMS
+		push	bc
+		call	_prof_mark
+		pop	bc
+	ENDIF
+
 		; int main(const int argc, const char *argv[])
 		call	_main
 
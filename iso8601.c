@@ -12,6 +12,7 @@
 #include <ctype.h>
 
 #include "iso8601.h"
+#include "format.h"
 
 static int validate_iso8601(const char *str)
 {
@@ -75,19 +76,59 @@ int str_to_iso8601(const char *str, iso8601_datetime *dt)
 	return 0;
 }
 
+/*
+ * Conversion to and from seconds since the Unix epoch, using the
+ * days-from-civil algorithm.  Valid from 1970 to 2105.
+ */
+
+unsigned long iso8601_to_epoch(const iso8601_datetime *dt)
+{
+	unsigned int y, m, yoe, doy;
+	unsigned long doe, days;
+
+	y = dt->year;
+	m = dt->mon;
+	y -= m <= 2;
+	yoe = y % 400;
+	doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + dt->day - 1;
+	doe = (unsigned long)yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	days = (y / 400) * 146097UL + doe - 719468UL;
+
+	return days * 86400UL + dt->hour * 3600UL + dt->min * 60U + dt->sec;
+}
+
+void epoch_to_iso8601(unsigned long t, iso8601_datetime *dt)
+{
+	unsigned long z, doe;
+	unsigned int era, yoe, doy, mp, y;
+	unsigned long secs;
+
+	secs = t % 86400UL;
+	dt->hour = secs / 3600;
+	dt->min  = (secs / 60) % 60;
+	dt->sec  = secs % 60;
+
+	z = t / 86400UL + 719468UL;
+	era = z / 146097UL;
+	doe = z - era * 146097UL;
+	yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	y = yoe + era * 400;
+	doy = doe - (365UL * yoe + yoe / 4 - yoe / 100);
+	mp = (5 * doy + 2) / 153;
+	dt->day = doy - (153 * mp + 2) / 5 + 1;
+	dt->mon = mp < 10 ? mp + 3 : mp - 9;
+	dt->year = y + (dt->mon <= 2);
+}
+
 int iso8601_to_str(const iso8601_datetime *dt, char *buf, int len)
 {
 	/*
 	 * Format:
 	 *	YYYY '-' MM '-' DD 'T' hh ':' mm ':' ss
 	 */
-	if (len < ISO8601_DT_LEN + 1)
+	if (format_time(format_iso, dt, 0, buf, len) < 0)
 		return -1;
 
-	sprintf(buf, "%04d-%02d-%02dT%02d:%02d:%02d",
-		dt->year, dt->mon, dt->day,
-		dt->hour, dt->min, dt->sec);
-
 	return 0;
 }
 
@@ -101,3 +142,28 @@ int iso8601_display(const iso8601_datetime *dt)
 	printf("%s\r\n", buf);
 	return 0;
 }
+
+/*
+ * Local time, followed by its offset from UTC in minutes:
+ *	YYYY '-' MM '-' DD 'T' hh ':' mm ':' ss ( '+' | '-' ) hh ':' mm
+ */
+
+int iso8601_to_str_offset(const iso8601_datetime *dt, int offset,
+			  char *buf, int len)
+{
+	if (format_time(format_iso_offset, dt, offset, buf, len) < 0)
+		return -1;
+
+	return 0;
+}
+
+int iso8601_display_offset(const iso8601_datetime *dt, int offset)
+{
+	char buf[ISO8601_DT_LEN + ISO8601_OFF_LEN + 1];
+
+	if (iso8601_to_str_offset(dt, offset, buf, sizeof buf) == -1)
+		return -1;
+
+	printf("%s\r\n", buf);
+	return 0;
+}
@@ -9,6 +9,7 @@
 #define ISO8601_H_
 
 #define ISO8601_DT_LEN	19
+#define ISO8601_OFF_LEN	6	// "+hh:mm"
 
 typedef struct iso8601_datetime
 {
@@ -22,7 +23,12 @@ typedef struct iso8601_datetime
 
 int dow_from_date(int y, int m, int d);
 int str_to_iso8601(const char *str, iso8601_datetime *dt);
+unsigned long iso8601_to_epoch(const iso8601_datetime *dt);
+void epoch_to_iso8601(unsigned long t, iso8601_datetime *dt);
 int iso8601_to_str(const iso8601_datetime *dt, char *buf, int len);
 int iso8601_display(const iso8601_datetime *dt);
+int iso8601_to_str_offset(const iso8601_datetime *dt, int offset,
+			  char *buf, int len);
+int iso8601_display_offset(const iso8601_datetime *dt, int offset);
 
 #endif // ISO8601_H_
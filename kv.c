@@ -0,0 +1,389 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  kv.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "strings.h"
+#include "bus.h"
+#include "rtc.h"
+#include "kv.h"
+#include "mos-interface.h"
+
+extern char debug;
+
+/*
+ * Stores.  The PCF85063 has a single RAM byte, which is too small for the
+ * header, so it is listed for completeness but always falls back to the
+ * file.  The DS1307 shares address 0x68 with the DS3231 on MOD-RTC2, so
+ * kv_nvram_check makes sure that what answers there is RAM.
+ */
+static const kv_store kv_stores[] = {
+	{ "file",	0,	0,	KV_MAX_LEN },
+	{ "ds1307",	0x68,	0x08,	56 },
+	{ "mcp7940n",	0x6F,	0x20,	64 },
+	{ "pcf85063",	0x51,	0x03,	1 },
+	{ NULL }
+};
+
+static const kv_key kv_keys[] = {
+	{ "drift",	KV_KEY_DRIFT,	KV_TYPE_NUM },
+	{ "speed",	KV_KEY_SPEED,	KV_TYPE_NUM },
+	{ "tz",		KV_KEY_TZ,	KV_TYPE_STR },
+	{ "drift2",	KV_KEY_DRIFT2,	KV_TYPE_NUM },
+	{ "synced",	KV_KEY_SYNCED,	KV_TYPE_NUM },
+	{ "cpu",	KV_KEY_CPU,	KV_TYPE_NUM },
+	{ NULL }
+};
+
+const kv_store *kv = &kv_stores[0];
+
+static unsigned char kv_image[KV_MAX_LEN];
+
+// Largest register transfer, within the MOS I2C limit with the address byte
+#define KV_CHUNK		16
+
+const kv_store *kv_find_store(const char *name)
+{
+	int i;
+
+	for (i = 0; kv_stores[i].name != NULL; ++i)
+		if (strcasecmp(name, kv_stores[i].name) == 0)
+			return &kv_stores[i];
+
+	return NULL;
+}
+
+const kv_key *kv_find_key(const char *name)
+{
+	int i;
+
+	for (i = 0; kv_keys[i].name != NULL; ++i)
+		if (strcasecmp(name, kv_keys[i].name) == 0)
+			return &kv_keys[i];
+
+	return NULL;
+}
+
+// Usable size of the selected store, or 0 if it cannot hold the header
+static unsigned int kv_capacity(void)
+{
+	unsigned int size = kv->size;
+
+	if (size > KV_MAX_LEN)
+		size = KV_MAX_LEN;
+	return size > KV_HDR_LEN ? size : 0;
+}
+
+// Fletcher-16 over the length byte and the entries
+static unsigned short kv_checksum(void)
+{
+	unsigned int sum1, sum2, i, end = KV_HDR_LEN + kv_image[1];
+
+	sum1 = sum2 = kv_image[1];
+	for (i = KV_HDR_LEN; i < end; ++i) {
+		sum1 = (sum1 + kv_image[i]) % 255;
+		sum2 = (sum2 + sum1) % 255;
+	}
+
+	return (sum2 << 8) | sum1;
+}
+
+/*
+ * NVRAM access, in chunks.  The bus must already be open, so the store can
+ * be read in the same session as the time.
+ */
+
+static int kv_nvram_read(unsigned char off, unsigned char *buf,
+			 unsigned int len)
+{
+	unsigned char reg;
+	unsigned int n;
+
+	while (len > 0) {
+		n = len < KV_CHUNK ? len : KV_CHUNK;
+		reg = kv->base + off;
+		if (bus_xfer(kv->addr, &reg, 1, buf, n) < 0)
+			return -1;
+		off += n;
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int kv_nvram_write(unsigned char off, const unsigned char *buf,
+			  unsigned int len)
+{
+	unsigned char chunk[1 + KV_CHUNK];
+	unsigned int n;
+
+	while (len > 0) {
+		n = len < KV_CHUNK ? len : KV_CHUNK;
+		chunk[0] = kv->base + off;
+		memcpy(&chunk[1], buf, n);
+		if (bus_xfer(kv->addr, chunk, 1 + n, NULL, 0) < 0)
+			return -1;
+		off += n;
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/*
+ * kv_nvram_check - refuse a store at the MOD-RTC2's address unless it is
+ * RAM.  The DS3231 temperature register sits inside the DS1307 store and
+ * ignores writes, so write it inverted, read it back and restore it.
+ */
+
+static int kv_nvram_check(void)
+{
+	static char checked;
+	unsigned char reg, orig, probe[2], got;
+
+	if (kv->addr != MOD_RTC2_I2C_ADDR || checked)
+		return 0;
+
+	reg = MOD_RTC2_REG_TEMP_MSB;
+	if (bus_xfer(kv->addr, &reg, 1, &orig, 1) < 0)
+		return -1;
+
+	probe[0] = reg;
+	probe[1] = ~orig;
+	if (bus_xfer(kv->addr, probe, 2, NULL, 0) < 0 ||
+	    bus_xfer(kv->addr, &reg, 1, &got, 1) < 0)
+		return -1;
+
+	if (got != probe[1]) {
+		printf("A DS3231 answers at %02x, not a %s\r\n",
+		       kv->addr, kv->name);
+		return -1;
+	}
+
+	probe[1] = orig;
+	if (bus_xfer(kv->addr, probe, 2, NULL, 0) < 0)
+		return -1;
+
+	checked = 1;
+	return 0;
+}
+
+static void kv_empty(void)
+{
+	kv_image[0] = KV_MAGIC;
+	kv_image[1] = 0;
+	kv_image[2] = 0;
+	kv_image[3] = 0;
+}
+
+/*
+ * kv_load - read and check the store, leaving it empty if it is invalid
+ */
+
+int kv_load(void)
+{
+	const kv_store *file = &kv_stores[0];
+	unsigned int cap, got;
+	unsigned short sum;
+	UINT8 fh;
+
+	kv_empty();
+
+	// Fall back to the file if the RTC has no usable NVRAM
+	if (kv_capacity() == 0)
+		kv = file;
+	cap = kv_capacity();
+
+	if (kv->addr == 0) {
+		fh = mos_fopen(KV_FILE, fa_read | fa_open_existing);
+		if (fh == 0)
+			return -1;
+		got = mos_fread(fh, (char *)kv_image, cap);
+		mos_fclose(fh);
+		if (got < KV_HDR_LEN) {
+			kv_empty();
+			return -1;
+		}
+	}
+	else {
+		if (kv_nvram_check() < 0 ||
+		    kv_nvram_read(0, kv_image, KV_HDR_LEN) < 0) {
+			kv_empty();
+			return -1;
+		}
+		got = KV_HDR_LEN + kv_image[1];
+		if (kv_image[0] != KV_MAGIC || got > cap)
+			got = 0;
+		else if (kv_nvram_read(KV_HDR_LEN, &kv_image[KV_HDR_LEN],
+				       kv_image[1]) < 0) {
+			kv_empty();
+			return -1;
+		}
+	}
+
+	if (kv_image[0] != KV_MAGIC || KV_HDR_LEN + kv_image[1] > got) {
+		if (debug)
+			printf("[kv %s empty]\r\n", kv->name);
+		kv_empty();
+		return -1;
+	}
+
+	sum = kv_checksum();
+	if (kv_image[2] != (sum & 0xff) || kv_image[3] != (sum >> 8)) {
+		if (debug)
+			printf("[kv %s invalid]\r\n", kv->name);
+		kv_empty();
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * kv_save - checksum and write the store
+ */
+
+int kv_save(void)
+{
+	unsigned int len = KV_HDR_LEN + kv_image[1];
+	unsigned short sum;
+	UINT8 fh;
+
+	if (kv_capacity() == 0)
+		kv = &kv_stores[0];
+
+	kv_image[0] = KV_MAGIC;
+	sum = kv_checksum();
+	kv_image[2] = sum & 0xff;
+	kv_image[3] = sum >> 8;
+
+	if (kv->addr != 0)
+		return kv_nvram_check() < 0 ? -1 :
+		       kv_nvram_write(0, kv_image, len);
+
+	fh = mos_fopen(KV_FILE, fa_write | fa_create_always);
+	if (fh == 0)
+		return -1;
+	if (mos_fwrite(fh, (char *)kv_image, len) != len) {
+		mos_fclose(fh);
+		return -1;
+	}
+	mos_fclose(fh);
+
+	return 0;
+}
+
+// Offset of the entry for key, or -1
+static int kv_find(unsigned char key)
+{
+	unsigned int i, end = KV_HDR_LEN + kv_image[1];
+
+	for (i = KV_HDR_LEN; i + 1 < end; i += 2 + kv_image[i + 1])
+		if (kv_image[i] == key)
+			return i;
+
+	return -1;
+}
+
+/*
+ * kv_get - copy up to len bytes of the value for key into buf, returning
+ * the full length of the value, or -1 if there is none
+ */
+
+int kv_get(unsigned char key, void *buf, unsigned char len)
+{
+	int i = kv_find(key);
+
+	if (i < 0)
+		return -1;
+
+	if (len > kv_image[i + 1])
+		len = kv_image[i + 1];
+	memcpy(buf, &kv_image[i + 2], len);
+
+	return kv_image[i + 1];
+}
+
+/*
+ * kv_set - replace the value for key, in memory only until kv_save.  The
+ * store must have been loaded first.
+ */
+
+int kv_set(unsigned char key, const void *buf, unsigned char len)
+{
+	unsigned int end = KV_HDR_LEN + kv_image[1];
+	unsigned int size;
+	int i = kv_find(key);
+
+	// Remove any existing entry
+	if (i >= 0) {
+		size = 2 + kv_image[i + 1];
+		memmove(&kv_image[i], &kv_image[i + size], end - i - size);
+		end -= size;
+	}
+
+	if (end + 2 + len > kv_capacity())
+		return -1;
+
+	kv_image[end] = key;
+	kv_image[end + 1] = len;
+	memcpy(&kv_image[end + 2], buf, len);
+	kv_image[1] = end + 2 + len - KV_HDR_LEN;
+
+	return 0;
+}
+
+// Numbers are stored as 4 bytes, least significant first
+int kv_get_num(unsigned char key, long *value)
+{
+	unsigned char b[4];
+
+	if (kv_get(key, b, sizeof b) != sizeof b)
+		return -1;
+
+	*value = (long)b[0] | (long)b[1] << 8 | (long)b[2] << 16 |
+		 (long)b[3] << 24;
+	return 0;
+}
+
+int kv_set_num(unsigned char key, long value)
+{
+	unsigned char b[4];
+
+	b[0] = value;
+	b[1] = value >> 8;
+	b[2] = value >> 16;
+	b[3] = value >> 24;
+
+	return kv_set(key, b, sizeof b);
+}
+
+void kv_show(void)
+{
+	char str[KV_STR_MAX + 1];
+	long value;
+	int i, len;
+
+	printf("Store: %s\r\n", kv->name);
+	for (i = 0; kv_keys[i].name != NULL; ++i) {
+		if (kv_keys[i].type == KV_TYPE_NUM) {
+			if (kv_get_num(kv_keys[i].key, &value) == 0)
+				printf("%s=%ld\r\n", kv_keys[i].name, value);
+		}
+		else {
+			len = kv_get(kv_keys[i].key, str, KV_STR_MAX);
+			if (len >= 0) {
+				str[len < KV_STR_MAX ? len : KV_STR_MAX] = 0;
+				printf("%s=%s\r\n", kv_keys[i].name, str);
+			}
+		}
+	}
+}
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  kv.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef KV_H_
+#define KV_H_
+
+/*
+ * Layout, the same in RTC NVRAM and in the fallback file:
+ *
+ *	magic, length, fletcher-16 (2 bytes), entries
+ *
+ * where length is the number of bytes of entries, each of which is
+ *
+ *	key, value length, value
+ */
+#define KV_MAGIC		0xC5
+#define KV_HDR_LEN		4
+#define KV_MAX_LEN		128
+
+// File used when the selected RTC has no NVRAM
+#define KV_FILE			"/mos/hwclock.kv"
+
+// Keys
+#define KV_KEY_DRIFT		1	// MOD-RTC drift, ppb (number)
+#define KV_KEY_SPEED		2	// I2C bus speed ID (number)
+#define KV_KEY_TZ		3	// Time-zone id (string)
+#define KV_KEY_DRIFT2		4	// MOD-RTC2 drift, ppb (number)
+#define KV_KEY_SYNCED		5	// Last -select, Unix seconds (number)
+#define KV_KEY_CPU		6	// eZ80 crystal error, ppb (number)
+
+#define KV_TYPE_NUM		0
+#define KV_TYPE_STR		1
+#define KV_STR_MAX		16
+
+typedef struct kv_key {
+	const char	*name;
+	unsigned char	key;
+	unsigned char	type;
+} kv_key;
+
+// Backing stores: a file, or battery-backed RAM in an I2C RTC
+typedef struct kv_store {
+	const char	*name;
+	int		addr;		// I2C address, 0 for the file
+	unsigned char	base;		// First RAM register
+	unsigned char	size;		// Bytes of RAM
+} kv_store;
+
+extern const kv_store *kv;
+
+const kv_store *kv_find_store(const char *name);
+const kv_key *kv_find_key(const char *name);
+
+int kv_load(void);
+int kv_save(void);
+int kv_get(unsigned char key, void *buf, unsigned char len);
+int kv_set(unsigned char key, const void *buf, unsigned char len);
+int kv_get_num(unsigned char key, long *value);
+int kv_set_num(unsigned char key, long value);
+void kv_show(void);
+
+#endif // KV_H_
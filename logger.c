@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  logger.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Long-running log of hardware vs system clock offset and temperature.
+ *  Records are collected in RAM and written in large blocks, so the SD
+ *  card sees one write every LOG_BUF_RECORDS samples.  At long intervals
+ *  a block is also written once it is LOG_FLUSH_S seconds old, so a power
+ *  cut cannot lose days of records.  MOS has no f_sync, so the file is
+ *  closed after each block to commit it, and opened again for the next.
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+
+#include "rtc.h"
+#include "logger.h"
+#include "temp.h"
+#include "mos-interface.h"
+
+static unsigned char log_buf[LOG_BUF_RECORDS * LOG_RECORD_LEN];
+
+static void put32(unsigned char *p, unsigned long v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static void put16(unsigned char *p, int v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static unsigned long get32(const unsigned char *p)
+{
+	return (unsigned long)p[0] | (unsigned long)p[1] << 8 |
+	       (unsigned long)p[2] << 16 | (unsigned long)p[3] << 24;
+}
+
+static int get16(const unsigned char *p)
+{
+	return (short)(p[0] | p[1] << 8);
+}
+
+static int log_flush(UINT8 fh, unsigned int records)
+{
+	unsigned int len = records * LOG_RECORD_LEN;
+
+	if (records == 0)
+		return 0;
+
+	return mos_fwrite(fh, (char *)log_buf, len) == len ? 0 : -1;
+}
+
+// Close the file to commit the block and its directory entry to the card,
+// and open it again.  Returns the new handle, or 0.
+static UINT8 log_reopen(UINT8 fh, const char *filename)
+{
+	mos_fclose(fh);
+
+	return mos_fopen((char *)filename, fa_write | fa_open_append);
+}
+
+static void log_sample(char device, unsigned char *rec)
+{
+	clock_pair p;
+	int temp, conv;
+
+	// Start a temperature conversion, which runs while the clocks are read
+	conv = device == 2 ? temp_start() : -1;
+
+	if (read_both(device, &p) < 0) {
+		// Keep the schedule, marking the sample as missing
+		put32(&rec[0], 0);
+		put32(&rec[4], 0);
+		p.hc_stamp = p.sys_stamp = mos_sysvars()->clock;
+	}
+	else {
+		put32(&rec[0], iso8601_to_epoch(&p.hc));
+		put32(&rec[4], iso8601_to_epoch(&p.sys));
+	}
+	put32(&rec[8], p.hc_stamp);
+	put16(&rec[12], (int)(p.sys_stamp - p.hc_stamp));
+
+	if (conv == 0)
+		while ((conv = temp_poll()) == TEMP_BUSY)
+			;
+	if (conv != TEMP_DONE || read_modrtc2_temp(&temp) < 0)
+		temp = LOG_NO_TEMP;
+	put16(&rec[14], temp);
+}
+
+/*
+ * log_run - sample every interval seconds until a key is pressed
+ */
+
+int log_run(char device, const char *filename, unsigned int interval)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	unsigned long next, flushed;
+	unsigned int n, total;
+	UINT8 fh;
+
+	if (interval == 0)
+		return -1;
+
+	fh = mos_fopen((char *)filename, fa_write | fa_open_append);
+	if (fh == 0) {
+		printf("Unable to open '%s'\r\n", filename);
+		return -1;
+	}
+
+	printf("Logging every %u s, press a key to stop\r\n", interval);
+
+	n = 0;
+	total = 0;
+	sysvars->keyascii = 0;
+	next = sysvars->clock;
+	flushed = next;
+	while (sysvars->keyascii == 0) {
+		// Wait for the sample time, on a fixed schedule so the
+		// sampling itself does not make it drift
+		while ((long)(sysvars->clock - next) < 0)
+			if (sysvars->keyascii != 0)
+				break;
+		if (sysvars->keyascii != 0)
+			break;
+		next += (unsigned long)interval * 100;
+
+		log_sample(device, &log_buf[n * LOG_RECORD_LEN]);
+		++total;
+		if (++n == LOG_BUF_RECORDS ||
+		    sysvars->clock - flushed >= LOG_FLUSH_S * 100UL) {
+			if (log_flush(fh, n) < 0) {
+				printf("Unable to write '%s'\r\n", filename);
+				mos_fclose(fh);
+				return -1;
+			}
+			fh = log_reopen(fh, filename);
+			if (fh == 0) {
+				printf("Unable to reopen '%s', %u records "
+				       "written\r\n", filename, total);
+				return -1;
+			}
+			n = 0;
+			flushed = sysvars->clock;
+		}
+	}
+	sysvars->keyascii = 0;
+
+	if (log_flush(fh, n) < 0)
+		printf("Unable to write '%s'\r\n", filename);
+	mos_fclose(fh);
+
+	printf("%u records written\r\n", total);
+
+	return 0;
+}
+
+/*
+ * log_export - convert a binary log to CSV
+ */
+
+int log_export(const char *binname, const char *csvname)
+{
+	static char line[80];
+	iso8601_datetime hc, sys;
+	char hcstr[ISO8601_DT_LEN + 1], sysstr[ISO8601_DT_LEN + 1];
+	unsigned char *rec;
+	unsigned int got, i, len;
+	int temp;
+	UINT8 in, out;
+
+	in = mos_fopen((char *)binname, fa_read | fa_open_existing);
+	if (in == 0) {
+		printf("Unable to open '%s'\r\n", binname);
+		return -1;
+	}
+	out = mos_fopen((char *)csvname, fa_write | fa_create_always);
+	if (out == 0) {
+		printf("Unable to open '%s'\r\n", csvname);
+		mos_fclose(in);
+		return -1;
+	}
+
+	len = sprintf(line, "hc,sys,offset_s,skew_cs,mos_clock,temp_c\r\n");
+	mos_fwrite(out, line, len);
+
+	while ((got = mos_fread(in, (char *)log_buf, sizeof log_buf)) > 0) {
+		for (i = 0; i + LOG_RECORD_LEN <= got; i += LOG_RECORD_LEN) {
+			rec = &log_buf[i];
+			epoch_to_iso8601(get32(&rec[0]), &hc);
+			epoch_to_iso8601(get32(&rec[4]), &sys);
+			iso8601_to_str(&hc, hcstr, sizeof hcstr);
+			iso8601_to_str(&sys, sysstr, sizeof sysstr);
+			len = sprintf(line, "%s,%s,%ld,%d,%lu,",
+				      hcstr, sysstr,
+				      (long)(get32(&rec[0]) - get32(&rec[4])),
+				      get16(&rec[12]), get32(&rec[8]));
+
+			temp = get16(&rec[14]);
+			if (temp != LOG_NO_TEMP)
+				len += sprintf(&line[len], "%s%d.%02d",
+					       temp < 0 ? "-" : "",
+					       (temp < 0 ? -temp : temp) / 4,
+					       (temp < 0 ? -temp : temp) % 4 * 25);
+			line[len++] = '\r';
+			line[len++] = '\n';
+			mos_fwrite(out, line, len);
+		}
+		if (got < sizeof log_buf)
+			break;
+	}
+
+	mos_fclose(out);
+	mos_fclose(in);
+
+	return 0;
+}
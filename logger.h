@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  logger.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef LOGGER_H_
+#define LOGGER_H_
+
+/*
+ * Record layout, 16 bytes, all fields least significant byte first:
+ *
+ *	0	hardware clock, Unix seconds		(4)
+ *	4	system clock, Unix seconds		(4)
+ *	8	MOS clock at the hardware clock sample	(4)
+ *	12	system sample time minus hardware, cs	(2, signed)
+ *	14	DS3231 temperature, 0.25C		(2, signed)
+ */
+#define LOG_RECORD_LEN		16
+#define LOG_NO_TEMP		(-32767 - 1)
+
+// Records held in RAM between writes to the SD card
+#define LOG_BUF_RECORDS		256
+
+// Longest time records are held before being written, seconds: a safety
+// net for long intervals, since up to about 84 s the buffer fills first
+#define LOG_FLUSH_S		21600
+
+int log_run(char device, const char *filename, unsigned int interval);
+int log_export(const char *binname, const char *csvname);
+
+#endif // LOGGER_H_
@@ -10,28 +10,130 @@
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <ctype.h>
 #include <ERRNO.H>
 
 #include "strings.h"
 #include "i2c.h"
+#include "bus.h"
 #include "rtc.h"
+#include "bench.h"
+#include "kv.h"
+#include "watch.h"
+#include "logger.h"
+#include "temp.h"
+#include "tz.h"
+#include "format.h"
+#include "gps.h"
+#include "serve.h"
+#include "select.h"
+#include "info.h"
+#include "resync.h"
+#include "timebase.h"
+#include "alarm.h"
+#include "mux.h"
+#include "prof.h"
+#include "prt.h"
 
 #include "mos-interface.h"
 
-char debug;
+extern char debug;
 char device;
+char local;
+
+// Clocks behind multiplexers, in place of the device
+static mux_clock mux_clocks[MUX_MAX_CLOCKS];
+static int mux_n;
+
+// Output format chosen with -format, or NULL for the default
+static const unsigned char *fmt;
+static unsigned char fmt_ops[FORMAT_MAX_OPS];
+
+// Convert a UTC time to local time, returning the offset in minutes
+static int to_local(iso8601_datetime *dt)
+{
+	int offset;
+
+	epoch_to_iso8601(tz_to_local(iso8601_to_epoch(dt), &offset), dt);
+	return offset;
+}
+
+// Convert a local time to UTC, returning the offset in minutes
+static int from_local(iso8601_datetime *dt)
+{
+	int offset;
+
+	epoch_to_iso8601(tz_from_local(iso8601_to_epoch(dt), &offset), dt);
+	return offset;
+}
+
+// Display a time, offset minutes ahead of UTC, in the chosen format
+static void display(const iso8601_datetime *dt, int offset)
+{
+	char buf[FORMAT_MAX_OPS * FORMAT_MAX_FIELD];
+
+	if (fmt != NULL) {
+		if (format_time(fmt, dt, offset, buf, sizeof buf) >= 0)
+			printf("%s\r\n", buf);
+	}
+	else if (local)
+		iso8601_display_offset(dt, offset);
+	else
+		iso8601_display(dt);
+}
+
+// Display a Hardware Clock time, which is UTC
+static void display_hc(const iso8601_datetime *dt)
+{
+	iso8601_datetime lt = *dt;
+
+	display(&lt, local ? to_local(&lt) : 0);
+}
+
+// Display a System Clock time, with its offset when it is local
+static void display_sys(const iso8601_datetime *dt)
+{
+	iso8601_datetime utc = *dt;
+
+	display(dt, local ? from_local(&utc) : 0);
+}
 
 int show_modrtc()
 {
 	iso8601_datetime dt;
-	int res;
+	int i, res;
 
-	if ((device == 1 ? read_modrtc(&dt) : read_modrtc2(&dt)) == -1)
-		return -1;
+	if (mux_n == 0) {
+		if ((device == 1 ? read_modrtc(&dt) : read_modrtc2(&dt)) == -1)
+			return -1;
 
-	iso8601_display(&dt);
+		display_hc(&dt);
 
-	return 0;
+		return 0;
+	}
+
+	res = 0;
+	for (i = 0; i < mux_n; ++i) {
+		printf("%u:%u:%d  ", mux_clocks[i].mux, mux_clocks[i].channel,
+		       mux_clocks[i].type);
+		if (mux_read(mux_clocks, mux_n, i, &dt) == 0)
+			display_hc(&dt);
+		else {
+			printf("unreadable\r\n");
+			res = -1;
+		}
+	}
+
+	return res;
+}
+
+// Write the Hardware Clock, or every clock behind the muxes at once
+static int write_hc(iso8601_datetime *dt)
+{
+	if (mux_n)
+		return mux_set(mux_clocks, mux_n, dt);
+
+	return device == 1 ? write_modrtc(dt) : write_modrtc2(dt);
 }
 
 int show_sysrtc()
@@ -43,7 +145,7 @@ int show_sysrtc()
 		return -1;
 	}
 
-	iso8601_display(&dt);
+	display_sys(&dt);
 
 	return 0;
 }
@@ -59,6 +161,9 @@ int hctosys(void)
 		return -1;
 	}
 
+	if (local)
+		to_local(&dt);
+
 	if (write_sysrtc(&dt) == -1) {
 		printf("Unable to write date and time to system\r\n");
 		return -1;
@@ -77,7 +182,10 @@ int systohc(void)
 		return -1;
 	}
 
-	if ((device == 1 ? write_modrtc(&dt) : write_modrtc2(&dt)) == -1) {
+	if (local)
+		from_local(&dt);
+
+	if (write_hc(&dt) == -1) {
 		printf("Unable to write date and time to MOD-RTC\r\n");
 		return -1;
 	}
@@ -94,7 +202,10 @@ static int set_modrtc(const char *datestr)
 		return -1;
 	}
 
-	if ((device == 1 ? write_modrtc(&dt) : write_modrtc2(&dt)) == -1) {
+	if (local)
+		from_local(&dt);
+
+	if (write_hc(&dt) == -1) {
 		printf("Unable to write date and time to MOD-RTC\r\n");
 		return -1;
 	}
@@ -102,6 +213,72 @@ static int set_modrtc(const char *datestr)
 	return 0;
 }
 
+// Sleep until the Hardware Clock reaches the given time
+static int wait_until(const char *datestr)
+{
+	iso8601_datetime dt;
+	int res;
+
+	if (str_to_iso8601(datestr, &dt) < 0) {
+		printf("Invalid ISO8601 date and time: '%s'\r\n", datestr);
+		return -1;
+	}
+
+	if (local)
+		from_local(&dt);
+
+	res = alarm_wait_until(device, iso8601_to_epoch(&dt));
+	if (res == ALARM_KEY)
+		printf("Interrupted\r\n");
+	else if (res < 0)
+		printf("Unable to set the alarm on MOD-RTC\r\n");
+
+	return res;
+}
+
+// Sample both clocks at nearly the same instant and show the offset
+static int compare(void)
+{
+	clock_pair p;
+	iso8601_datetime sys;
+	int res;
+
+	res = read_both(device, &p);
+	if (res == -2) {
+		printf("Unable to read date and time from system\r\n");
+		return -1;
+	}
+	if (res == -1) {
+		printf("Unable to read date and time from MOD-RTC\r\n");
+		return -1;
+	}
+
+	printf("Hardware Clock: ");
+	display_hc(&p.hc);
+	printf("System Clock:   ");
+	display_sys(&p.sys);
+
+	sys = p.sys;
+	if (local)
+		from_local(&sys);
+	printf("Offset: %ld s, sampled %ld cs apart\r\n",
+	       (long)(iso8601_to_epoch(&p.hc) - iso8601_to_epoch(&sys)),
+	       (long)(p.hc_stamp - p.sys_stamp));
+
+	return 0;
+}
+
+// Compare transaction latency of the I2C transports
+static int busbench(void)
+{
+	if (device == 1)
+		return bench_bus(MOD_RTC_I2C_ADDR, MOD_RTC_REG_SEC,
+				 BENCH_DEFAULT_COUNT);
+	else
+		return bench_bus(MOD_RTC2_I2C_ADDR, MOD_RTC2_REG_SEC,
+				 BENCH_DEFAULT_COUNT);
+}
+
 static int set_sysrtc(const char *datestr)
 {
 	iso8601_datetime dt;
@@ -119,9 +296,147 @@ static int set_sysrtc(const char *datestr)
 	return 0;
 }
 
+// Load settings from the selected store and apply the bus speed
+static int load_config(void)
+{
+	char nvram = kv->addr != 0;
+	long value;
+	int res;
+
+	if (nvram)
+		bus_open();
+	res = kv_load();
+	if (nvram)
+		bus_close();
+
+	if (kv_get_num(KV_KEY_SPEED, &value) == 0 &&
+	    value >= 0 && value < I2C_SPEEDS)
+		bus_speed = value;
+
+	// Timing from the system clock uses the measured crystal
+	if (kv_get_num(KV_KEY_CPU, &value) == 0)
+		prt_calibrate(value);
+
+	return res;
+}
+
+// Load the table named by the tz setting, /mos/tz/<id>.tzc
+static int load_tz_setting(void)
+{
+	char path[sizeof TZ_DIR + KV_STR_MAX + sizeof TZ_EXT];
+	int len;
+
+	len = kv_get(KV_KEY_TZ, path + sizeof TZ_DIR - 1, KV_STR_MAX);
+	if (len < 0)
+		return -1;
+	if (len > KV_STR_MAX)
+		len = KV_STR_MAX;
+
+	memcpy(path, TZ_DIR, sizeof TZ_DIR - 1);
+	strcpy(path + sizeof TZ_DIR - 1 + len, TZ_EXT);
+
+	return tz_load(path);
+}
+
+static int show_config(void)
+{
+	load_config();
+	kv_show();
+
+	return 0;
+}
+
+// Write the settings back to the selected store
+static int save_config(void)
+{
+	char nvram = kv->addr != 0;
+	int res;
+
+	if (nvram)
+		bus_open();
+	res = kv_save();
+	if (nvram)
+		bus_close();
+	if (res < 0)
+		printf("Unable to save settings to %s\r\n", kv->name);
+
+	return res;
+}
+
+static int set_config(const char *name, const char *value)
+{
+	const kv_key *key;
+	int res;
+
+	key = kv_find_key(name);
+	if (key == NULL) {
+		printf("Unknown setting: '%s'\r\n", name);
+		return -1;
+	}
+
+	load_config();
+
+	if (key->type == KV_TYPE_NUM)
+		res = kv_set_num(key->key, strtol(value, NULL, 0));
+	else if (strlen(value) <= KV_STR_MAX)
+		res = kv_set(key->key, value, strlen(value));
+	else
+		res = -1;
+	if (res < 0) {
+		printf("Unable to store setting '%s'\r\n", name);
+		return -1;
+	}
+
+	return save_config();
+}
+
+// Measure the eZ80 crystal against the hardware clock, and store the
+// result if there is a store
+static int calibrate(unsigned int seconds, char save)
+{
+	long ppb;
+
+	if (seconds == 0 || seconds > TIMEBASE_CAL_MAX_S) {
+		printf("Calibrate for 1 to %u seconds\r\n",
+		       TIMEBASE_CAL_MAX_S);
+		return -1;
+	}
+
+	if (timebase_calibrate(device, seconds, &ppb) < 0)
+		return -1;
+
+	prt_calibrate(ppb);
+	printf("CPU clock %lu Hz, %ld ppb\r\n", prt_cpu_hz(), ppb);
+
+	if (!save) {
+		printf("Use -kv to store it as the cpu setting\r\n");
+		return 0;
+	}
+
+	return kv_set_num(KV_KEY_CPU, ppb) < 0 || save_config() < 0 ? -1 : 0;
+}
+
+// Set every clock from the best, recording when if there is a store
+static int select_sync(char save)
+{
+	unsigned long synced;
+
+	if (select_clocks(&synced) < 0)
+		return -1;
+
+	if (save && (kv_set_num(KV_KEY_SYNCED, synced) < 0 ||
+		     save_config() < 0))
+		return -1;
+
+	return 0;
+}
+
 void usage(const char *prgname)
 {
-	printf("Usage: %s [ -debug ] [ -1 | -2 ] < command >\r\n"
+	printf("Usage: %s [ -debug ] [ -bus reg|mos|bb ] [ -bbpins port,scl,sda ]\r\n"
+	       "       [ -kv store ] [ -delta ] [ -tz file ] [ -local ] [ -format fmt ]\r\n"
+	       "       [ -baud rate ] [ -pps ] [ -threshold cs ] [ -1 | -2 | -mux list ]\r\n"
+	       "       < command >\r\n"
 	       "or     %s -help\r\n", prgname, prgname);
 }
 
@@ -130,6 +445,22 @@ void help(const char *prgname)
 	usage(prgname);
 	printf( "\r\n"
 		"\t-debug   Enable RTC debugging\r\n"
+		"\t-bus     Select I2C transport: reg (default), mos, or bb\r\n"
+		"\t-bbpins  GPIO pins for -bus bb: port, SCL, SDA (default C,2,3)\r\n"
+		"\t-delta   Write only changed Hardware Clock registers, and verify\r\n"
+		"\t-kv      Settings store: file (default), ds1307, mcp7940n\r\n"
+		"\t-local   System Clock, -sethc and display use local time,\r\n"
+		"\t         with the zone from the tz setting (needs -kv)\r\n"
+		"\t-tz      As -local, with a zone table made by tzcomp\r\n"
+		"\t-format  Output format: iso, extended, basic, epoch, rfc2822,\r\n"
+		"\t         or a pattern of %%Y %%y %%m %%d %%H %%M %%S %%s %%z %%:z\r\n"
+		"\t         %%a %%b %%j %%F %%T and %%%%\r\n"
+		"\t-baud    UART1 baud rate (default 9600 for -gps, 115200 for -serve)\r\n"
+		"\t-pps     Align -gps to the PPS edge on GPIO PC4\r\n"
+		"\t-mux     Clocks behind TCA9548A muxes, in place of -1 or -2:\r\n"
+		"\t         mux:channel:type,... (-showhc, -sethc, -systohc)\r\n"
+		"\t-threshold System Clock error that -resync corrects,\r\n"
+		"\t         centiseconds (default 50)\r\n"
 		"\r\n"
 		"\t-1       Select MOD-RTC\r\n"
 		"\t-2       Select MOD-RTC2\r\n"
@@ -139,9 +470,34 @@ void help(const char *prgname)
 		"\r\n"
 		"\t-showhc  Show the date and time of the Hardware Clock\r\n"
 		"\t-showsys Show the date and time of the System Clock\r\n"
+		"\t-compare Show both clocks, sampled together, and their offset\r\n"
+		"\t-select  Read every clock, and set the others from the best\r\n"
+		"\t-watch   Show the Hardware Clock until a key is pressed\r\n"
+		"\t-timebase Show the CPU timer rate against the 1Hz output\r\n"
+		"\t-calibrate Measure the CPU crystal against the 1Hz output,\r\n"
+		"\t         storing it with -kv: [seconds] (default 60)\r\n"
+		"\t-temp    Show the MOD-RTC2 temperature, freshly converted\r\n"
+		"\t-log     Log clock offset and temperature: <file> <seconds>\r\n"
+		"\t-logcsv  Convert a log to CSV: <file> <csvfile>\r\n"
 		"\r\n"
 		"\t-sethc   Set the Hardware Clock\r\n"
 		"\t-setsys  set the System Time\r\n"
+		"\t-gps     Set the Hardware Clock from a GPS on UART1\r\n"
+		"\t-wait-until Sleep until the Hardware Clock reaches a time\r\n"
+		"\r\n"
+		"\t-serve   Answer time requests on UART1 until a key is pressed\r\n"
+		"\t-resync  Keep the System Clock set from the Hardware Clock\r\n"
+		"\t         until a key is pressed\r\n"
+		"\t-boot    As -hctosys at boot, skipping it when a warm reset\r\n"
+		"\t         left the System Clock good\r\n"
+		"\r\n"
+		"\t-busbench Compare latency of the I2C transports\r\n"
+		"\t-bench   Qualify the bus at every speed: [count]\r\n"
+		"\t-info    Show the image size, and the load time of each variant\r\n"
+		"\r\n"
+		"\t-showcfg Show the stored settings\r\n"
+		"\t-setcfg  Store a setting: drift <ppb>, drift2 <ppb>, speed <0-3>,\r\n"
+		"\t         tz <id>, cpu <ppb>\r\n"
 		"\r\n"
 		"\tExample: %s -1 -sethc 2022-04-07T08:30:00\r\n"
 		"\r\n", prgname);
@@ -158,7 +514,36 @@ typedef enum {
 	opt_modrtc,
 	opt_modrtc2,
 	opt_help,
-	opt_debug
+	opt_debug,
+	opt_bus,
+	opt_busbench,
+	opt_delta,
+	opt_kv,
+	opt_showcfg,
+	opt_setcfg,
+	opt_compare,
+	opt_watch,
+	opt_log,
+	opt_logcsv,
+	opt_temp,
+	opt_tz,
+	opt_local,
+	opt_format,
+	opt_gps,
+	opt_pps,
+	opt_baud,
+	opt_serve,
+	opt_select,
+	opt_info,
+	opt_resync,
+	opt_threshold,
+	opt_timebase,
+	opt_waituntil,
+	opt_bench,
+	opt_mux,
+	opt_bbpins,
+	opt_boot,
+	opt_calibrate
 } hwclock_opt;
 
 typedef struct  hwclock_arg {
@@ -166,7 +551,7 @@ typedef struct  hwclock_arg {
 	hwclock_opt opt;
 } hwclock_arg;
 
-#define HWCLOCK_ARGS	10
+#define HWCLOCK_ARGS	39
 
 static const hwclock_arg hwclock_args[HWCLOCK_ARGS] = {
 	{ "-systohc",	opt_systohc },
@@ -179,6 +564,35 @@ static const hwclock_arg hwclock_args[HWCLOCK_ARGS] = {
 	{ "-2",		opt_modrtc2 },
 	{ "-help",	opt_help },
 	{ "-debug",	opt_debug },
+	{ "-bus",	opt_bus },
+	{ "-busbench",	opt_busbench },
+	{ "-delta",	opt_delta },
+	{ "-kv",	opt_kv },
+	{ "-showcfg",	opt_showcfg },
+	{ "-setcfg",	opt_setcfg },
+	{ "-compare",	opt_compare },
+	{ "-watch",	opt_watch },
+	{ "-log",	opt_log },
+	{ "-logcsv",	opt_logcsv },
+	{ "-temp",	opt_temp },
+	{ "-tz",	opt_tz },
+	{ "-local",	opt_local },
+	{ "-format",	opt_format },
+	{ "-gps",	opt_gps },
+	{ "-pps",	opt_pps },
+	{ "-baud",	opt_baud },
+	{ "-serve",	opt_serve },
+	{ "-select",	opt_select },
+	{ "-info",	opt_info },
+	{ "-resync",	opt_resync },
+	{ "-threshold",	opt_threshold },
+	{ "-timebase",	opt_timebase },
+	{ "-wait-until",	opt_waituntil },
+	{ "-bench",	opt_bench },
+	{ "-mux",	opt_mux },
+	{ "-bbpins",	opt_bbpins },
+	{ "-boot",	opt_boot },
+	{ "-calibrate",	opt_calibrate },
 };
 
 int main(int argc, const char * argv[])
@@ -187,9 +601,18 @@ int main(int argc, const char * argv[])
 	hwclock_opt opt;
 	hwclock_opt cmd = opt_nothing;
 	const char *datestr = NULL;
+	const char *arg1 = NULL, *arg2 = NULL;
+	const char *tzfile = NULL;
+	unsigned long baud = 0;
+	unsigned int threshold = RESYNC_THRESHOLD_CS;
+	unsigned int count = BENCH_SOAK_COUNT;
+	unsigned int seconds = TIMEBASE_CAL_S;
+	char pps = 0;
+	char kv_selected = 0;
 
 	debug = 0;
 	device = 0;
+	local = 0;
 
 	if (argc == 1) {
 		usage(argv[0]);
@@ -218,15 +641,32 @@ int main(int argc, const char * argv[])
 				device = 2;
 				break;
 
+			case opt_temp:
+				if (device != 2) {
+					usage(argv[0]);
+					return 19;
+				}
+				// fall-through
 			case opt_systohc:
 			case opt_hctosys:
 			case opt_showhc:
-				if (device == 0) {
+			case opt_busbench:
+			case opt_compare:
+			case opt_watch:
+			case opt_gps:
+			case opt_serve:
+			case opt_resync:
+			case opt_boot:
+			case opt_timebase:
+				if (device == 0 && mux_n == 0) {
 					usage(argv[0]);
 					return 19;
 				}
 				// fall-through
 			case opt_showsys:
+			case opt_showcfg:
+			case opt_select:
+			case opt_info:
 			case opt_help:
 				if (cmd == opt_nothing)
 					cmd = opt;
@@ -237,7 +677,8 @@ int main(int argc, const char * argv[])
 				break;
 
 			case opt_sethc:
-				if (device == 0) {
+			case opt_waituntil:
+				if (device == 0 && mux_n == 0) {
 					usage(argv[0]);
 					return 19;
 				}
@@ -257,6 +698,181 @@ int main(int argc, const char * argv[])
 			case opt_debug:
 				++debug;
 				break;
+
+			case opt_delta:
+				rtc_delta = 1;
+				break;
+
+			case opt_local:
+				local = 1;
+				break;
+
+			case opt_pps:
+				pps = 1;
+				break;
+
+			case opt_baud:
+				if (argc - i > 1 &&
+				    (baud = strtoul(argv[i + 1], NULL, 10)) != 0)
+					++i;
+				else {
+					usage(argv[0]);
+					return 19;
+				}
+				break;
+
+			case opt_mux:
+				if (argc - i > 1 &&
+				    (mux_n = mux_parse(argv[i + 1], mux_clocks,
+						       MUX_MAX_CLOCKS)) > 0)
+					++i;
+				else {
+					printf("Invalid mux list, expected "
+					       "mux:channel:type,...\r\n");
+					usage(argv[0]);
+					return 19;
+				}
+				break;
+
+			case opt_bench:
+				if (cmd != opt_nothing) {
+					usage(argv[0]);
+					return 19;
+				}
+				cmd = opt;
+				if (argc - i > 1 && isdigit(argv[i + 1][0]))
+					count = (unsigned int)
+						strtoul(argv[++i], NULL, 10);
+				break;
+
+			case opt_calibrate:
+				if (device == 0 || cmd != opt_nothing) {
+					usage(argv[0]);
+					return 19;
+				}
+				cmd = opt;
+				if (argc - i > 1 && isdigit(argv[i + 1][0]))
+					seconds = (unsigned int)
+						strtoul(argv[++i], NULL, 10);
+				break;
+
+			case opt_threshold:
+				if (argc - i > 1 && (threshold = (unsigned int)
+				    strtoul(argv[i + 1], NULL, 10)) != 0)
+					++i;
+				else {
+					usage(argv[0]);
+					return 19;
+				}
+				break;
+
+			case opt_format:
+				if (argc - i < 2) {
+					usage(argv[0]);
+					return 19;
+				}
+				++i;
+				fmt = format_find(argv[i]);
+				if (fmt == NULL &&
+				    format_compile(argv[i], fmt_ops,
+						   sizeof fmt_ops) == 0)
+					fmt = fmt_ops;
+				if (fmt == NULL) {
+					printf("Invalid format: '%s'\r\n", argv[i]);
+					return 19;
+				}
+				break;
+
+			case opt_tz:
+				if (argc - i > 1) {
+					tzfile = argv[++i];
+					local = 1;
+				}
+				else {
+					usage(argv[0]);
+					return 19;
+				}
+				break;
+
+			case opt_kv:
+				if (argc - i > 1 &&
+				    (kv = kv_find_store(argv[i + 1])) != NULL) {
+					kv_selected = 1;
+					++i;
+				}
+				else {
+					usage(argv[0]);
+					return 19;
+				}
+				break;
+
+			case opt_log:
+				if (device == 0) {
+					usage(argv[0]);
+					return 19;
+				}
+				// fall-through
+			case opt_logcsv:
+			case opt_setcfg:
+				if (cmd == opt_nothing && argc - i > 2) {
+					cmd = opt;
+					arg1 = argv[i + 1];
+					arg2 = argv[i + 2];
+					i += 2;
+				}
+				else {
+					usage(argv[0]);
+					return 19;
+				}
+				break;
+
+			case opt_bus:
+				if (argc - i > 1 &&
+				    (bus = bus_find(argv[i + 1])) != NULL)
+					++i;
+				else {
+					usage(argv[0]);
+					return 19;
+				}
+				break;
+
+			case opt_bbpins:
+				if (argc - i > 1 && bus_bb_pins(argv[i + 1]) == 0)
+					++i;
+				else {
+					usage(argv[0]);
+					return 19;
+				}
+				break;
+		}
+	}
+	PROF_MARK(PROF_ARGS);
+
+	// A store at the MOD-RTC2's address would be written over its
+	// registers; kv_load and kv_save also check what answers there
+	if (kv->addr == MOD_RTC2_I2C_ADDR &&
+	    (device == 2 || cmd == opt_select || cmd == opt_compare)) {
+		printf("-kv %s shares the MOD-RTC2's address\r\n", kv->name);
+		usage(argv[0]);
+		return 19;
+	}
+
+	if (mux_n && cmd != opt_showhc && cmd != opt_sethc &&
+	    cmd != opt_systohc) {
+		printf("-mux works with -showhc, -sethc and -systohc\r\n");
+		return 19;
+	}
+
+	// Settings are only fetched when a store is named, to keep the
+	// common path free of SD card access
+	if (kv_selected && cmd != opt_showcfg && cmd != opt_setcfg)
+		load_config();
+
+	if (local) {
+		if (tzfile != NULL ? tz_load(tzfile) < 0 :
+		    !kv_selected || load_tz_setting() < 0) {
+			printf("Unable to load time zone\r\n");
+			return 19;
 		}
 	}
 
@@ -276,12 +892,66 @@ int main(int argc, const char * argv[])
 		case opt_showsys:
 			show_sysrtc();
 			break;
+		case opt_compare:
+			compare();
+			break;
+		case opt_watch:
+			watch(device);
+			break;
 		case opt_sethc:
 			set_modrtc(datestr);
 			break;
+		case opt_waituntil:
+			wait_until(datestr);
+			break;
 		case opt_setsys:
 			set_sysrtc(datestr);
 			break;
+		case opt_busbench:
+			busbench();
+			break;
+		case opt_bench:
+			bench_soak(device, count);
+			break;
+		case opt_calibrate:
+			calibrate(seconds, kv_selected);
+			break;
+		case opt_showcfg:
+			show_config();
+			break;
+		case opt_setcfg:
+			set_config(arg1, arg2);
+			break;
+		case opt_log:
+			log_run(device, arg1, atoi(arg2));
+			break;
+		case opt_logcsv:
+			log_export(arg1, arg2);
+			break;
+		case opt_temp:
+			temp_show();
+			break;
+		case opt_gps:
+			gps_set(device, pps, baud ? baud : GPS_DEFAULT_BAUD);
+			break;
+		case opt_serve:
+			serve(device, baud ? baud : SERVE_DEFAULT_BAUD);
+			break;
+		case opt_select:
+			select_sync(kv_selected);
+			break;
+		case opt_info:
+			info_show();
+			break;
+		case opt_resync:
+			resync(device, threshold);
+			break;
+		case opt_boot:
+			resync_boot(device, threshold);
+			break;
+		case opt_timebase:
+			timebase_show(device);
+			break;
 		case opt_help:
 			help(argv[0]);
 			break;
@@ -290,5 +960,8 @@ int main(int argc, const char * argv[])
 			return 19;
 	}
 
+	bus_report();
+	PROF_REPORT();
+
 	return 0;
 }
@@ -24,6 +24,10 @@
 	XDEF _mos_getrtc
 	XDEF _mos_setrtc
 	XDEF _mos_sysvars
+	XDEF _mos_i2c_open
+	XDEF _mos_i2c_close
+	XDEF _mos_i2c_write
+	XDEF _mos_i2c_read
 	XDEF _getsysvar_cursorX
 	XDEF _getsysvar_cursorY
 	XDEF _getsysvar_scrchar
@@ -342,4 +346,54 @@ _mos_sysvars:
 	pop	ix
 	ret
 
+_mos_i2c_open:
+	push	ix
+	ld	ix,0
+	add	ix,sp
+
+	ld	c,(ix+6)	; frequency ID
+	ld	a,mos_i2c_open
+	rst.lil	08h		; returns nothing
+
+	ld	sp,ix
+	pop	ix
+	ret
+
+_mos_i2c_close:
+	push	ix
+	ld	a,mos_i2c_close
+	rst.lil	08h		; returns nothing
+	pop	ix
+	ret
+
+_mos_i2c_write:
+	push	ix
+	ld	ix,0
+	add	ix,sp
+
+	ld	c,(ix+6)	; I2C target address
+	ld	b,(ix+9)	; number of bytes to write (max 32)
+	ld	hl,(ix+12)	; buffer
+	ld	a,mos_i2c_write
+	rst.lil	08h		; returns status in A
+
+	ld	sp,ix
+	pop	ix
+	ret
+
+_mos_i2c_read:
+	push	ix
+	ld	ix,0
+	add	ix,sp
+
+	ld	c,(ix+6)	; I2C target address
+	ld	b,(ix+9)	; number of bytes to read (max 32)
+	ld	hl,(ix+12)	; buffer
+	ld	a,mos_i2c_read
+	rst.lil	08h		; returns status in A
+
+	ld	sp,ix
+	pop	ix
+	ret
+
 	end
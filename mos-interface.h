@@ -121,4 +121,15 @@ extern UINT8 mos_feof(UINT8 fh);					 // returns 1 if EOF, 0 otherwise
 extern void mos_setrtc(const unsigned char *rtcbuf);
 extern int mos_getrtc(unsigned char *rtcbuf);
 
+// I2C API (MOS 1.04 onwards)
+#define MOS_I2C_OK		0
+#define MOS_I2C_NORESPONSE	1
+#define MOS_I2C_ARB_LOST	2
+#define MOS_I2C_BUS_ERROR	3
+
+extern void mos_i2c_open(UINT8 frequency);
+extern void mos_i2c_close(void);
+extern UINT8 mos_i2c_write(UINT8 target_addr, UINT8 len, unsigned char *buf);
+extern UINT8 mos_i2c_read(UINT8 target_addr, UINT8 len, unsigned char *buf);
+
 #endif MOS_H
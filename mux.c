@@ -0,0 +1,189 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  mux.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Clocks behind TCA9548A I2C multiplexers.  Each mux connects any set of
+ *  its eight channels to the bus, so clocks of the same type, which share
+ *  an address, can be read one at a time, or all written at once: every
+ *  one of them sees the same transaction, and starts its second together.
+ *
+ *  A DS3231 starts a new second as its seconds register is written.  A
+ *  PCF8563 is stopped while its time is loaded, and on release first
+ *  increments about half a second later, so it is released that much
+ *  before the DS3231s' first increment.
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bus.h"
+#include "rtc.h"
+#include "prt.h"
+#include "mux.h"
+#include "mos-interface.h"
+
+extern char debug;
+
+static int mux_digit(char c, int max)
+{
+	return c >= '0' && c <= '0' + max ? c - '0' : -1;
+}
+
+/*
+ * mux_parse - parse a comma-separated list of mux:channel:type, returning
+ * the number of clocks or -1
+ */
+
+int mux_parse(const char *list, mux_clock *clocks, int max)
+{
+	int n = 0, mux, channel, type;
+
+	for (;;) {
+		if (n == max)
+			return -1;
+
+		mux = mux_digit(list[0], MUX_MAX_MUXES - 1);
+		if (mux < 0 || list[1] != ':')
+			return -1;
+		channel = mux_digit(list[2], MUX_CHANNELS - 1);
+		if (channel < 0 || list[3] != ':')
+			return -1;
+		type = mux_digit(list[4], 2);
+		if (type < 1)
+			return -1;
+
+		clocks[n].mux = mux;
+		clocks[n].channel = channel;
+		clocks[n].type = type;
+		++n;
+
+		if (list[5] == '\0')
+			return n;
+		if (list[5] != ',')
+			return -1;
+		list += 6;
+	}
+}
+
+/*
+ * mux_connect - on every mux in the list, connect the channels holding
+ * clocks of the given type, or only clock number only if that is not -1,
+ * and disconnect the rest.  Type 0 disconnects everything.
+ */
+
+static int mux_connect(const mux_clock *clocks, int n, char type, int only)
+{
+	unsigned char masks[MUX_MAX_MUXES];
+	unsigned char used = 0;
+	int i, res = 0;
+
+	memset(masks, 0, sizeof masks);
+	for (i = 0; i < n; ++i) {
+		used |= 1 << clocks[i].mux;
+		if (only >= 0 ? i == only : clocks[i].type == type)
+			masks[clocks[i].mux] |= 1 << clocks[i].channel;
+	}
+
+	bus_open();
+	for (i = 0; i < MUX_MAX_MUXES && res == 0; ++i)
+		if (used & (1 << i))
+			res = bus_xfer(MUX_I2C_ADDR + i, &masks[i], 1, NULL, 0);
+	bus_close();
+
+	if (res < 0) {
+		printf("Unable to select mux channels (%d)\r\n", res);
+		return -1;
+	}
+
+	return 0;
+}
+
+// Read clock number i, on its own
+int mux_read(const mux_clock *clocks, int n, int i, iso8601_datetime *dt)
+{
+	int res;
+
+	if (mux_connect(clocks, n, 0, i) < 0)
+		return -1;
+	res = clocks[i].type == 1 ? read_modrtc(dt) : read_modrtc2(dt);
+	mux_connect(clocks, n, 0, -1);
+
+	return res;
+}
+
+// Stop or start every connected PCF8563
+static int mux_stop_modrtc(char stop)
+{
+	unsigned char ctrl = stop ? MOD_RTC_CTRL1_STOP : 0;
+	int res;
+
+	bus_open();
+	res = rtc_write_regs(MOD_RTC_I2C_ADDR, MOD_RTC_REG_CTRL1, &ctrl, 1);
+	bus_close();
+
+	return res;
+}
+
+/*
+ * mux_set - set every clock to dt, each one's next second starting one
+ * second from now
+ */
+
+int mux_set(const mux_clock *clocks, int n, iso8601_datetime *dt)
+{
+	char have1 = 0, have2 = 0, stopped = 0, delta;
+	unsigned long ticks = 0;
+	prt_mark m;
+	int i, res = -1;
+
+	for (i = 0; i < n; ++i) {
+		if (clocks[i].type == 1)
+			have1 = 1;
+		else
+			have2 = 1;
+	}
+
+	// The clocks answer a read all at once, so no delta writes
+	delta = rtc_delta;
+	rtc_delta = 0;
+	prt_open();
+
+	if (have1) {
+		if (mux_connect(clocks, n, 1, -1) < 0)
+			goto out;
+		stopped = 1;
+		if (mux_stop_modrtc(1) < 0 || write_modrtc(dt) < 0)
+			goto out;
+	}
+	prt_mark_now(&m);
+
+	if (have2) {
+		if (mux_connect(clocks, n, 2, -1) < 0 ||
+		    write_modrtc2(dt) < 0)
+			goto out;
+		prt_mark_now(&m);
+	}
+	res = 0;
+
+out:
+	if (stopped) {
+		if (mux_connect(clocks, n, 1, -1) < 0)
+			res = -1;
+		else {
+			while (res == 0 && ticks <
+			       PRT_US_TO_TICKS(1000000UL - MUX_PCF_FIRST_US))
+				ticks += prt_elapsed(&m);
+			if (mux_stop_modrtc(0) < 0) {
+				printf("Unable to restart MOD-RTC\r\n");
+				res = -1;
+			}
+		}
+	}
+	mux_connect(clocks, n, 0, -1);
+	rtc_delta = delta;
+
+	return res;
+}
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  mux.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef MUX_H_
+#define MUX_H_
+
+#include "iso8601.h"
+
+// TCA9548A I2C multiplexers, at 0x70 + the mux number
+#define MUX_I2C_ADDR		0x70
+#define MUX_MAX_MUXES		8
+#define MUX_CHANNELS		8
+
+#define MUX_MAX_CLOCKS		16
+
+/*
+ * Once STOP is released, the PCF8563 first increments its seconds after
+ * between 507813 and 507935 microseconds, rather than a whole second
+ */
+#define MUX_PCF_FIRST_US	507874UL
+
+// A clock behind a mux, written mux:channel:type, type as -1 or -2
+typedef struct mux_clock {
+	unsigned char	mux;
+	unsigned char	channel;
+	char		type;
+} mux_clock;
+
+int mux_parse(const char *list, mux_clock *clocks, int max);
+int mux_read(const mux_clock *clocks, int n, int i, iso8601_datetime *dt);
+int mux_set(const mux_clock *clocks, int n, iso8601_datetime *dt);
+
+#endif // MUX_H_
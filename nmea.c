@@ -0,0 +1,244 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  nmea.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Streaming parser for the NMEA 0183 RMC and ZDA sentences:
+ *
+ *	$--RMC,hhmmss.ss,A,llll.ll,a,yyyyy.yy,a,x.x,x.x,ddmmyy,x.x,a*hh
+ *	$--ZDA,hhmmss.ss,dd,mm,yyyy,xx,xx*hh
+ *
+ *  It has no dependency on the eZ80, so it also builds on the host for
+ *  tools/nmeabench.c.
+ */
+
+#include <string.h>
+
+#include "nmea.h"
+
+#define NMEA_IDLE		0	// Waiting for '$'
+#define NMEA_FIELDS		1	// Within the sentence
+#define NMEA_SUM_HI		2	// Expecting the first checksum digit
+#define NMEA_SUM_LO		3	// Expecting the second checksum digit
+
+#define NMEA_HAVE_TIME		0x01
+#define NMEA_HAVE_DATE		0x02
+#define NMEA_HAVE_VALID		0x04
+#define NMEA_HAVE_ALL		0x07
+
+void nmea_init(nmea_parser *p)
+{
+	memset(p, 0, sizeof *p);
+}
+
+static int hexval(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return -1;
+}
+
+// Value of len digits at s, or -1 if any is not a digit
+static int digits(const char *s, int len)
+{
+	int v = 0;
+
+	while (len-- > 0) {
+		if (*s < '0' || *s > '9')
+			return -1;
+		v = v * 10 + *s++ - '0';
+	}
+
+	return v;
+}
+
+// hhmmss[.sss]
+static int nmea_time_field(nmea_parser *p)
+{
+	int h, m, s, i, scale;
+
+	if (p->len < 6)
+		return -1;
+	h = digits(p->buf, 2);
+	m = digits(p->buf + 2, 2);
+	s = digits(p->buf + 4, 2);
+	if (h < 0 || h > 23 || m < 0 || m > 59 || s < 0 || s > 60)
+		return -1;
+
+	p->cur.dt.hour = h;
+	p->cur.dt.min = m;
+	p->cur.dt.sec = s;
+	p->cur.ms = 0;
+
+	if (p->len > 6) {
+		if (p->buf[6] != '.')
+			return -1;
+		for (i = 7, scale = 100; i < p->len && scale > 0; ++i) {
+			if (p->buf[i] < '0' || p->buf[i] > '9')
+				return -1;
+			p->cur.ms += (p->buf[i] - '0') * scale;
+			scale /= 10;
+		}
+	}
+
+	p->have |= NMEA_HAVE_TIME;
+	return 0;
+}
+
+// ddmmyy, in RMC, taken to be in 2000-2099
+static int nmea_date_field(nmea_parser *p)
+{
+	int d, m, y;
+
+	if (p->len != 6)
+		return -1;
+	d = digits(p->buf, 2);
+	m = digits(p->buf + 2, 2);
+	y = digits(p->buf + 4, 2);
+	if (d < 1 || d > 31 || m < 1 || m > 12 || y < 0)
+		return -1;
+
+	p->cur.dt.day = d;
+	p->cur.dt.mon = m;
+	p->cur.dt.year = 2000 + y;
+	p->have |= NMEA_HAVE_DATE;
+	return 0;
+}
+
+// Decode the field just ended, returning -1 to abandon the sentence
+static int nmea_field(nmea_parser *p)
+{
+	int v;
+
+	if (p->field == 0) {
+		// Any talker: GP, GN, GL, ...
+		if (p->len != 5)
+			return -1;
+		if (memcmp(p->buf + 2, "RMC", 3) == 0)
+			p->type = NMEA_RMC;
+		else if (memcmp(p->buf + 2, "ZDA", 3) == 0)
+			p->type = NMEA_ZDA;
+		else
+			return -1;
+		return 0;
+	}
+
+	if (p->field == 1)
+		return p->len == 0 ? 0 : nmea_time_field(p);
+
+	if (p->type == NMEA_RMC) {
+		switch (p->field) {
+			case 2:
+				if (p->len == 1 && p->buf[0] == 'A')
+					p->have |= NMEA_HAVE_VALID;
+				break;
+			case 9:
+				return p->len == 0 ? 0 : nmea_date_field(p);
+		}
+		return 0;
+	}
+
+	// ZDA has no status; a date means the receiver has the time
+	switch (p->field) {
+		case 2:
+			v = digits(p->buf, p->len);
+			if (p->len == 0 || v < 1 || v > 31)
+				return p->len == 0 ? 0 : -1;
+			p->cur.dt.day = v;
+			break;
+		case 3:
+			v = digits(p->buf, p->len);
+			if (p->len == 0 || v < 1 || v > 12)
+				return p->len == 0 ? 0 : -1;
+			p->cur.dt.mon = v;
+			break;
+		case 4:
+			if (p->len != 4)
+				return p->len == 0 ? 0 : -1;
+			v = digits(p->buf, 4);
+			if (v < 0)
+				return -1;
+			p->cur.dt.year = v;
+			if (p->cur.dt.day != 0 && p->cur.dt.mon != 0)
+				p->have |= NMEA_HAVE_DATE | NMEA_HAVE_VALID;
+			break;
+	}
+
+	return 0;
+}
+
+/*
+ * nmea_feed - add one character, returning NMEA_RMC or NMEA_ZDA, with the
+ * time in t, when it completes a valid time sentence, else NMEA_NONE
+ */
+
+int nmea_feed(nmea_parser *p, char c, nmea_time *t)
+{
+	int v;
+
+	if (c == '$') {
+		p->state = NMEA_FIELDS;
+		p->type = NMEA_NONE;
+		p->field = 0;
+		p->len = 0;
+		p->sum = 0;
+		p->have = 0;
+		memset(&p->cur, 0, sizeof p->cur);
+		return NMEA_NONE;
+	}
+
+	switch (p->state) {
+		case NMEA_FIELDS:
+			if (c == ',' || c == '*') {
+				if (nmea_field(p) < 0) {
+					if (p->field > 0)
+						++p->bad_field;
+					p->state = NMEA_IDLE;
+					break;
+				}
+				++p->field;
+				p->len = 0;
+				if (c == '*') {
+					p->state = NMEA_SUM_HI;
+					break;
+				}
+			}
+			else if (c == '\r' || c == '\n') {
+				// No checksum, so not trusted
+				p->state = NMEA_IDLE;
+				break;
+			}
+			else if (p->len < NMEA_FIELD_MAX)
+				p->buf[p->len++] = c;
+			p->sum ^= c;
+			break;
+
+		case NMEA_SUM_HI:
+			v = hexval(c);
+			p->given = v << 4;
+			p->state = v < 0 ? NMEA_IDLE : NMEA_SUM_LO;
+			break;
+
+		case NMEA_SUM_LO:
+			p->state = NMEA_IDLE;
+			v = hexval(c);
+			if (v < 0 || (p->given | v) != p->sum) {
+				++p->bad_sum;
+				break;
+			}
+			if (p->have != NMEA_HAVE_ALL) {
+				++p->bad_field;
+				break;
+			}
+			++p->sentences;
+			*t = p->cur;
+			return p->type;
+	}
+
+	return NMEA_NONE;
+}
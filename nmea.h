@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  nmea.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef NMEA_H_
+#define NMEA_H_
+
+#include "iso8601.h"
+
+// Sentences that carry the date and time
+#define NMEA_NONE		0
+#define NMEA_RMC		1
+#define NMEA_ZDA		2
+
+// Longest field that is kept, e.g. "hhmmss.sss"
+#define NMEA_FIELD_MAX		12
+
+typedef struct nmea_time {
+	iso8601_datetime	dt;	// UTC
+	unsigned short		ms;	// Milliseconds into dt
+} nmea_time;
+
+/*
+ * Parser state.  Characters are fed one at a time as they arrive from the
+ * receiver, and each field is decoded as soon as it ends, so only the
+ * current field is buffered.
+ */
+typedef struct nmea_parser {
+	unsigned char	state;
+	unsigned char	type;		// NMEA_RMC or NMEA_ZDA
+	unsigned char	field;		// Index of the current field
+	unsigned char	len;		// Characters in buf
+	unsigned char	sum;		// XOR of the characters so far
+	unsigned char	given;		// Checksum from the sentence
+	unsigned char	have;		// Fields decoded, NMEA_HAVE_*
+	char		buf[NMEA_FIELD_MAX];
+	nmea_time	cur;
+
+	// Statistics
+	unsigned long	sentences;	// Time sentences accepted
+	unsigned long	bad_sum;	// Checksum mismatches
+	unsigned long	bad_field;	// Malformed or invalid fixes
+} nmea_parser;
+
+void nmea_init(nmea_parser *p);
+int nmea_feed(nmea_parser *p, char c, nmea_time *t);
+
+#endif // NMEA_H_
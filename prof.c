@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  prof.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Per-phase time from the PRT count started at _start.  Each mark charges
+ *  the time since the previous mark to its phase.
+ */
+
+#include <stdio.h>
+
+#include "prof.h"
+#include "prt.h"
+#include "mos-interface.h"
+
+#ifdef HWCLOCK_PROFILE
+
+static const char *prof_names[PROF_PHASES] = {
+	"clear_bss",
+	"parse_params",
+	"arguments",
+	"bus_open",
+	"bus_xfer",
+	"mos_setrtc",
+	"other"
+};
+
+static unsigned long prof_ticks[PROF_PHASES];
+static unsigned int prof_count[PROF_PHASES];
+
+// The BSS is clear when the first mark is made, which is also the count
+// the timer started from at _start
+static prt_mark prof_last;
+static char prof_started;
+
+void prof_mark(unsigned char phase)
+{
+	unsigned long ticks;
+
+	// clear_bss takes well under one wrap, so there is no MOS clock
+	// reading to check the first mark against
+	if (!prof_started) {
+		prof_last.cs = mos_sysvars()->clock;
+		prof_started = 1;
+	}
+	ticks = prt_elapsed(&prof_last);
+
+	prof_ticks[phase] += ticks;
+	++prof_count[phase];
+}
+
+void prof_report(void)
+{
+	unsigned long total = 0;
+	unsigned char i;
+
+	PROF_MARK(PROF_OTHER);
+	prt_stop();
+
+	printf("Phase          Calls          us\r\n");
+	for (i = 0; i < PROF_PHASES; ++i) {
+		total += prof_ticks[i];
+		printf("%-12s %7u %11lu\r\n", prof_names[i], prof_count[i],
+		       PRT_TICKS_TO_US(prof_ticks[i]));
+	}
+	printf("%-12s %7s %11lu\r\n", "total", "", PRT_TICKS_TO_US(total));
+}
+
+#endif // HWCLOCK_PROFILE
@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  prof.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Phase profiling probes.  Build with HWCLOCK_PROFILE defined (the
+ *  Profile configuration of hwclock.zdsproj) to have hwclock print where
+ *  its time went on exit; otherwise the probes compile to nothing.
+ */
+
+#ifndef PROF_H_
+#define PROF_H_
+
+// Phases; PROF_BSS and PROF_PARAMS are marked from init.asm
+#define PROF_BSS		0	// _start to the end of clear_bss
+#define PROF_PARAMS		1	// parse_params
+#define PROF_ARGS		2	// Argument matching in main()
+#define PROF_OPEN		3	// bus_open (i2c_init)
+#define PROF_XFER		4	// bus_xfer transactions
+#define PROF_SETRTC		5	// mos_setrtc VDP write
+#define PROF_OTHER		6	// Everything between the probes
+#define PROF_PHASES		7
+
+#ifdef HWCLOCK_PROFILE
+void prof_mark(unsigned char phase);
+void prof_report(void);
+
+#define PROF_MARK(phase)	prof_mark(phase)
+#define PROF_REPORT()		prof_report()
+#else
+#define PROF_MARK(phase)
+#define PROF_REPORT()
+#endif
+
+#endif // PROF_H_
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  proto.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Framing of the time service protocol.  It has no dependency on the
+ *  eZ80, so it also builds on the host for tools/protobench.c.
+ */
+
+#include <string.h>
+
+#include "proto.h"
+
+static unsigned char proto_check(const unsigned char *buf, int len)
+{
+	unsigned char x = 0;
+
+	while (len-- > 0)
+		x ^= *buf++;
+
+	return x;
+}
+
+void proto_init(proto_parser *p)
+{
+	memset(p, 0, sizeof *p);
+}
+
+/*
+ * proto_feed - add one received byte, returning 1 when it completes a
+ * valid request.  After a bad check the parser resynchronises on the next
+ * magic byte within the request.
+ */
+
+int proto_feed(proto_parser *p, unsigned char c)
+{
+	int i;
+
+	if (p->len == 0 && c != PROTO_REQ_MAGIC) {
+		++p->bad;
+		return 0;
+	}
+
+	p->buf[p->len++] = c;
+	if (p->len < PROTO_REQ_LEN)
+		return 0;
+
+	if (proto_check(p->buf, PROTO_REQ_LEN) == 0) {
+		p->len = 0;
+		++p->requests;
+		return 1;
+	}
+
+	// Drop the first byte, and anything up to the next magic byte
+	++p->bad;
+	for (i = 1; i < PROTO_REQ_LEN && p->buf[i] != PROTO_REQ_MAGIC; ++i)
+		++p->bad;
+	p->len = PROTO_REQ_LEN - i;
+	memmove(p->buf, &p->buf[i], p->len);
+
+	return 0;
+}
+
+unsigned char proto_cmd(const proto_parser *p)
+{
+	return p->buf[1];
+}
+
+/*
+ * proto_reply - build the reply to the request just completed, returning
+ * its length.  t is only used when status is PROTO_OK.
+ */
+
+int proto_reply(const proto_parser *p, unsigned char status,
+		const hwclock_time *t, unsigned char *out)
+{
+	memset(out, 0, PROTO_REP_LEN);
+	out[0] = PROTO_REP_MAGIC;
+	out[1] = p->buf[1];
+	out[2] = p->buf[2];
+	out[3] = status;
+
+	if (status == PROTO_OK && p->buf[1] == PROTO_CMD_TIME) {
+		out[4] = t->epoch;
+		out[5] = t->epoch >> 8;
+		out[6] = t->epoch >> 16;
+		out[7] = t->epoch >> 24;
+		out[8] = t->cs;
+		out[9] = t->unc;
+	}
+
+	out[PROTO_REP_LEN - 1] = proto_check(out, PROTO_REP_LEN - 1);
+
+	return PROTO_REP_LEN;
+}
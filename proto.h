@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  proto.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef PROTO_H_
+#define PROTO_H_
+
+#include "hwclock.h"
+
+/*
+ * Time service protocol.  A request is four bytes:
+ *
+ *	PROTO_REQ_MAGIC, command, sequence, check
+ *
+ * and each valid request is answered with twelve:
+ *
+ *	PROTO_REP_MAGIC, command, sequence, status,
+ *	epoch (4, least significant first), cs, uncertainty (cs), 0, check
+ *
+ * where check is the XOR of the preceding bytes.  The sequence number is
+ * chosen by the client and returned unchanged.
+ */
+#define PROTO_REQ_MAGIC		0xA5
+#define PROTO_REP_MAGIC		0x5A
+#define PROTO_REQ_LEN		4
+#define PROTO_REP_LEN		12
+
+// Commands
+#define PROTO_CMD_PING		0	// Reply without the time
+#define PROTO_CMD_TIME		1	// Interpolated hardware clock time
+
+// Status
+#define PROTO_OK		0
+#define PROTO_ERR_CLOCK		1	// The hardware clock could not be read
+#define PROTO_ERR_CMD		2	// Unknown command
+
+typedef struct proto_parser {
+	unsigned char	len;
+	unsigned char	buf[PROTO_REQ_LEN];
+
+	// Statistics
+	unsigned long	requests;
+	unsigned long	bad;		// Discarded bytes and bad checks
+} proto_parser;
+
+void proto_init(proto_parser *p);
+int proto_feed(proto_parser *p, unsigned char c);
+unsigned char proto_cmd(const proto_parser *p);
+int proto_reply(const proto_parser *p, unsigned char status,
+		const hwclock_time *t, unsigned char *out);
+
+#endif // PROTO_H_
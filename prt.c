@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  prt.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  A free-running count from one of the eZ80's programmable reload timers,
+ *  for timing things shorter than the 10ms MOS clock.
+ */
+
+#include <ez80.h>
+#include <stddef.h>
+
+#include "prt.h"
+#include "mos-interface.h"
+
+/*
+ * prt_start - (re)start the count.  Called from _start in profile builds,
+ * before the BSS is cleared, so it must not touch any variables.
+ */
+
+void prt_start(void)
+{
+	TMR1_CTL = 0;
+	TMR1_RR_L = 0;
+	TMR1_RR_H = 0;
+	TMR1_CTL = PRT_CTL_CONTINUOUS | PRT_CTL_DIV16 | PRT_CTL_RST_EN |
+		   PRT_CTL_EN;
+}
+
+// Start the count unless it is already running, for a profiled build
+void prt_open(void)
+{
+	if (!(TMR1_CTL & PRT_CTL_EN))
+		prt_start();
+}
+
+void prt_stop(void)
+{
+	TMR1_CTL = 0;
+}
+
+// Reading the low byte latches the high byte
+unsigned int prt_read(void)
+{
+	unsigned char lo;
+
+	lo = TMR1_DR_L;
+	return (unsigned int)TMR1_DR_H << 8 | lo;
+}
+
+// Ticks from one reading to a later one, modulo PRT_WRAP
+unsigned int prt_since(unsigned int from, unsigned int to)
+{
+	// The timer counts down
+	return (from - to) & 0xffff;
+}
+
+// Kept to save a MOS call on every mark, which tight polling loops make
+static struct mos_sysvars *prt_sysvars;
+
+void prt_mark_now(prt_mark *m)
+{
+	if (prt_sysvars == NULL)
+		prt_sysvars = mos_sysvars();
+
+	m->count = prt_read();
+	m->cs = prt_sysvars->clock;
+}
+
+/*
+ * prt_elapsed - ticks since the mark, which is moved on to now.  The count
+ * wraps every 56.9ms, so the MOS clock gives the number of whole wraps.
+ */
+
+unsigned long prt_elapsed(prt_mark *m)
+{
+	prt_mark now;
+	unsigned long ticks, coarse;
+
+	prt_mark_now(&now);
+	ticks = prt_since(m->count, now.count);
+
+	// Within one MOS tick the count cannot have wrapped, which keeps the
+	// multiply out of tight polling loops
+	if (now.cs != m->cs) {
+		coarse = (now.cs - m->cs) * (PRT_HZ / 100);
+		if (coarse > ticks)
+			ticks += (coarse - ticks + PRT_WRAP / 2) / PRT_WRAP *
+				 PRT_WRAP;
+	}
+
+	*m = now;
+
+	return ticks;
+}
+
+long prt_cpu_ppb;
+
+void prt_calibrate(long ppb)
+{
+	if (ppb > PRT_PPB_MAX)
+		ppb = PRT_PPB_MAX;
+	else if (ppb < -PRT_PPB_MAX)
+		ppb = -PRT_PPB_MAX;
+
+	prt_cpu_ppb = ppb;
+}
+
+// The real system clock, from the nominal one and the measured error
+unsigned long prt_cpu_hz(void)
+{
+	// PRT_CPU_HZ * ppb / 10^9, in steps that fit in 32 bits
+	return PRT_CPU_HZ +
+	       prt_cpu_ppb / 1000 * (long)(PRT_CPU_HZ / 1000) / 1000 +
+	       prt_cpu_ppb % 1000 * (long)(PRT_CPU_HZ / 1000) / 1000000L;
+}
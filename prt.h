@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  prt.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef PRT_H_
+#define PRT_H_
+
+// System clock feeding the programmable reload timers
+#define PRT_CPU_HZ		18432000UL
+
+// TMRx_CTL bits
+#define PRT_CTL_EN		(1 << 0)
+#define PRT_CTL_RST_EN		(1 << 1)
+#define PRT_CTL_DIV4		(0 << 2)
+#define PRT_CTL_DIV16		(1 << 2)
+#define PRT_CTL_DIV64		(2 << 2)
+#define PRT_CTL_DIV256		(3 << 2)
+#define PRT_CTL_CONTINUOUS	(1 << 4)
+
+/*
+ * TMR1 runs free from a reload of 0 (65536 counts), counting down at
+ * PRT_CPU_HZ / 16: 1.152MHz, wrapping every 56.9ms.  MOS only uses TMR0.
+ */
+#define PRT_DIV			16
+#define PRT_HZ			(PRT_CPU_HZ / PRT_DIV)
+#define PRT_WRAP		65536UL
+
+// Ticks to microseconds: 1000000 / 1152000 = 125 / 144, split so that a
+// long count does not overflow
+#define PRT_TICKS_TO_US(t)	((t) / 144 * 125 + (t) % 144 * 125 / 144)
+#define PRT_US_TO_TICKS(us)	((us) * 144 / 125)
+
+// Largest crystal error prt_calibrate accepts, ppb
+#define PRT_PPB_MAX		1000000L
+
+// A reading of the count, and of the MOS clock to recover lost wraps
+typedef struct prt_mark {
+	unsigned int	count;
+	unsigned long	cs;
+} prt_mark;
+
+void prt_start(void);
+void prt_open(void);
+void prt_stop(void);
+unsigned int prt_read(void);
+unsigned int prt_since(unsigned int from, unsigned int to);
+void prt_mark_now(prt_mark *m);
+unsigned long prt_elapsed(prt_mark *m);
+
+// The eZ80 crystal's measured error, ppb, 0 until set from the cpu setting
+extern long prt_cpu_ppb;
+
+void prt_calibrate(long ppb);
+unsigned long prt_cpu_hz(void);
+
+#endif // PRT_H_
@@ -0,0 +1,324 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  resync.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Keep the System Clock close to the Hardware Clock until a key is
+ *  pressed, writing it only when its error exceeds a threshold.
+ *
+ *  The System Clock only reports whole seconds, so one reading confines
+ *  its offset from the Hardware Clock (interpolated by hwclock_read) to a
+ *  window a second wide.  Each sample is timed for when the System Clock
+ *  is expected to change second, so that it halves the window; a few
+ *  samples pin the offset down to the VDP round trip.  The window is kept
+ *  between checks, widened by the drift that could have happened since.
+ *  The interval between checks doubles while the offset holds still, and
+ *  halves when it moves.
+ *
+ *  resync_boot does as little as it can at boot: nothing when a warm reset
+ *  left a believable System Clock, a check against the Hardware Clock when
+ *  a cold boot did, and an aligned write only when the check fails or the
+ *  System Clock is not believable.
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+
+#include "rtc.h"
+#include "hwclock.h"
+#include "tz.h"
+#include "resync.h"
+#include "mos-interface.h"
+
+extern char debug;
+extern char local;
+
+// Window width at which narrowing stops, and the most samples it may take
+#define RESYNC_NARROW_CS	4
+#define RESYNC_NARROW_TRIES	8
+
+static long off_lo, off_hi;		// System minus Hardware Clock, cs
+static char off_valid;
+static unsigned long off_stamp;		// MOS clock of the last sample
+static unsigned char off_phase;		// Centiseconds into the System
+					// Clock's second at off_stamp
+static unsigned long half_trip;		// Half the last VDP round trip
+
+static long abs_long(long v)
+{
+	return v < 0 ? -v : v;
+}
+
+// Take one sample and narrow the offset window.  Returns -1 if the
+// Hardware Clock could not be read and -2 if the System Clock could not.
+static int resync_sample(void)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	iso8601_datetime sys;
+	hwclock_time t;
+	unsigned long before, now, stamp, epoch, slack;
+	long secs, hc, lo, hi;
+	int res, sysres;
+
+	// Read the Hardware Clock while the VDP answers
+	before = sysvars->clock;
+	read_sysrtc_request();
+	res = hwclock_read(&t);
+	now = sysvars->clock;
+	read_sysrtc_ready();
+	sysres = read_sysrtc_complete(&sys, &stamp);
+	if (res < 0)
+		return -1;
+	if (sysres < 0)
+		return -2;
+	half_trip = stamp - before;
+
+	epoch = iso8601_to_epoch(&sys);
+	if (local)
+		epoch = tz_from_local(epoch, NULL);
+
+	secs = (long)(epoch - t.epoch);
+	if (secs > 1000000L)
+		secs = 1000000L;
+	else if (secs < -1000000L)
+		secs = -1000000L;
+
+	// Hardware Clock at the stamp, centiseconds into t.epoch, against a
+	// System Clock somewhere in its second secs
+	hc = t.cs - (long)(now - stamp);
+	lo = secs * 100 - hc - t.unc - (long)half_trip;
+	hi = secs * 100 + 99 - hc + t.unc + (long)half_trip;
+
+	if (off_valid) {
+		slack = (stamp - off_stamp) / (1000000L / RESYNC_DRIFT_PPM) + 1;
+		if (off_lo - (long)slack > lo)
+			lo = off_lo - (long)slack;
+		if (off_hi + (long)slack < hi)
+			hi = off_hi + (long)slack;
+
+		// Nothing fits both, so the System Clock has been set
+		if (lo > hi) {
+			if (debug)
+				printf("[offset window reset]\r\n");
+			lo = secs * 100 - hc - t.unc - (long)half_trip;
+			hi = secs * 100 + 99 - hc + t.unc + (long)half_trip;
+		}
+	}
+
+	off_lo = lo;
+	off_hi = hi;
+	off_stamp = stamp;
+	off_valid = 1;
+
+	// Where the System Clock is in its second, from the middle estimate
+	hc += (lo + hi) / 2;
+	off_phase = (unsigned char)(((hc % 100) + 100) % 100);
+
+	return 0;
+}
+
+// MOS clock to send the request so that the sample lands on a System Clock
+// second boundary, at least delay centiseconds after the last sample
+static unsigned long resync_when(unsigned long delay)
+{
+	unsigned long when;
+
+	when = off_stamp + delay + (100 - off_phase) % 100;
+	if (when - off_stamp < delay)
+		when += 100;
+
+	return when - half_trip;
+}
+
+// Write the System Clock as the Hardware Clock changes second
+static int resync_write(void)
+{
+	iso8601_datetime dt;
+	hwclock_time t;
+	unsigned long epoch;
+
+	if (hwclock_read(&t) < 0)
+		return -1;
+	epoch = t.epoch;
+	do {
+		if (hwclock_read(&t) < 0)
+			return -1;
+	} while (t.epoch == epoch);
+
+	epoch = t.epoch;
+	if (local)
+		epoch = tz_to_local(epoch, NULL);
+	epoch_to_iso8601(epoch, &dt);
+
+	return write_sysrtc(&dt);
+}
+
+int resync(char device, unsigned int threshold)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	unsigned int interval = RESYNC_MIN_S;
+	unsigned long next, checks = 0, writes = 0, errors = 0;
+	long mid, last_mid = 0, moved;
+	char have_last = 0;
+	int tries, res;
+
+	if (hwclock_open(device) < 0)
+		return -1;
+
+	printf("Keeping the System Clock within %u cs, press a key to stop\r\n",
+	       threshold);
+
+	off_valid = 0;
+	next = sysvars->clock;
+	sysvars->keyascii = 0;
+	while (sysvars->keyascii == 0) {
+		if ((long)(sysvars->clock - next) < 0)
+			continue;
+
+		// Narrow the window, one boundary at a time
+		for (tries = 1; (res = resync_sample()) == 0; ++tries) {
+			if (off_hi - off_lo <= RESYNC_NARROW_CS ||
+			    tries == RESYNC_NARROW_TRIES)
+				break;
+			next = resync_when(1);
+			while ((long)(sysvars->clock - next) < 0 &&
+			       sysvars->keyascii == 0)
+				;
+		}
+		if (res < 0) {
+			++errors;
+			off_valid = 0;
+			next = sysvars->clock + RESYNC_MIN_S * 100UL;
+			continue;
+		}
+		++checks;
+
+		mid = off_lo + (off_hi - off_lo) / 2;
+		if (debug)
+			printf("[offset %ld cs +/- %ld, interval %u s]\r\n",
+			       mid, (off_hi - off_lo + 1) / 2, interval);
+
+		if (abs_long(mid) > threshold) {
+			printf("System Clock off by %ld cs, ", mid);
+			if (resync_write() < 0) {
+				printf("unable to set it\r\n");
+				++errors;
+			}
+			else {
+				printf("set\r\n");
+				++writes;
+			}
+			off_valid = 0;
+			have_last = 0;
+			interval = RESYNC_MIN_S;
+			next = sysvars->clock + interval * 100UL;
+			continue;
+		}
+
+		// Back off while the drift is small against the threshold
+		if (have_last) {
+			moved = abs_long(mid - last_mid);
+			if (moved <= threshold / 4 && interval < RESYNC_MAX_S)
+				interval *= 2;
+			else if (moved > threshold / 2 &&
+				 interval > RESYNC_MIN_S)
+				interval /= 2;
+		}
+		last_mid = mid;
+		have_last = 1;
+
+		next = resync_when(interval * 100UL);
+	}
+	sysvars->keyascii = 0;
+
+	printf("%lu checks, %lu writes, %lu errors\r\n", checks, writes, errors);
+
+	return 0;
+}
+
+// A System Clock the ESP32 never had set reads as its epoch, or garbage
+static int boot_plausible(const iso8601_datetime *dt)
+{
+	return dt->year >= RESYNC_BOOT_MIN_YEAR &&
+	       dt->mon >= 1 && dt->mon <= 12 &&
+	       dt->day >= 1 && dt->day <= 31 &&
+	       dt->hour < 24 && dt->min < 60 && dt->sec < 60;
+}
+
+// The offset window lies wholly within threshold of the Hardware Clock
+static int boot_within(long threshold)
+{
+	return off_lo >= -threshold && off_hi <= threshold;
+}
+
+int resync_boot(char device, unsigned int threshold)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	iso8601_datetime dt;
+	unsigned long next;
+	long mid;
+	int tries, res;
+	char valid;
+
+	// Ask the VDP: sysvars->time only holds what MOS last received,
+	// which after a reset may be stale or nothing at all
+	read_sysrtc_request();
+	res = read_sysrtc_complete(&dt, NULL);
+	valid = res == 0 && boot_plausible(&dt);
+
+	if (!sysvars->coldBoot && valid) {
+		printf("Warm boot, System Clock valid, left alone\r\n");
+		return 0;
+	}
+
+	if (hwclock_open(device) < 0)
+		return -1;
+
+	if (valid) {
+		// Narrow the window as resync does, stopping as soon as it
+		// lies wholly within or outside the threshold
+		off_valid = 0;
+		for (tries = 1; (res = resync_sample()) == 0; ++tries) {
+			if (boot_within(threshold) ||
+			    off_lo > (long)threshold ||
+			    off_hi < -(long)threshold ||
+			    off_hi - off_lo <= RESYNC_NARROW_CS ||
+			    tries == RESYNC_NARROW_TRIES)
+				break;
+			next = resync_when(1);
+			while ((long)(sysvars->clock - next) < 0)
+				;
+		}
+		if (res == 0) {
+			mid = off_lo + (off_hi - off_lo) / 2;
+			if (boot_within(threshold)) {
+				printf("Cold boot, System Clock verified "
+				       "(%ld cs +/- %ld)\r\n",
+				       mid, (off_hi - off_lo + 1) / 2);
+				return 0;
+			}
+			printf("Cold boot, System Clock off by %ld cs, ", mid);
+		}
+		else if (res == -2)
+			printf("Cold boot, System Clock unreadable, ");
+		else {
+			printf("Cold boot, Hardware Clock unreadable, "
+			       "System Clock left alone\r\n");
+			return -1;
+		}
+	}
+	else
+		printf("%s boot, System Clock %s, ",
+		       sysvars->coldBoot ? "Cold" : "Warm",
+		       res < 0 ? "unreadable" : "implausible");
+
+	// Only reading the Hardware Clock can fail here
+	if (resync_write() < 0) {
+		printf("unable to read the Hardware Clock\r\n");
+		return -1;
+	}
+	printf("set at the Hardware Clock's second\r\n");
+
+	return 0;
+}
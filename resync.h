@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  resync.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef RESYNC_H_
+#define RESYNC_H_
+
+// Error in the System Clock that triggers a write, centiseconds
+#define RESYNC_THRESHOLD_CS	50
+
+// Bounds of the interval between checks, seconds
+#define RESYNC_MIN_S		8
+#define RESYNC_MAX_S		512
+
+// Worst drift allowed for between checks, ppm: the ESP32 crystal plus
+// the hardware clock's own
+#define RESYNC_DRIFT_PPM	100
+
+// Earliest year a System Clock is believed in by -boot
+#define RESYNC_BOOT_MIN_YEAR	2023
+
+int resync(char device, unsigned int threshold);
+int resync_boot(char device, unsigned int threshold);
+
+#endif // RESYNC_H_
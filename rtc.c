@@ -8,11 +8,20 @@
 #include <ez80.h>
 #include <stdio.h>
 
+#include "config.h"
 #include "i2c.h"
+#include "i2cfast.h"
+#include "bus.h"
 #include "bcd.h"
 #include "rtc.h"
+#include "prof.h"
 #include "mos-interface.h"
 
+extern char debug;
+
+// The boot variants only read one chip and write the system clock
+#ifndef HWCLOCK_BOOT
+
 /*
 static const char *WEEKDAYS[7] =
 	{ "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
@@ -30,65 +39,244 @@ static int dow_from_date(int y, int m, int d)
 	return (y + y/4 - y/100 + y/400 + t[m-1] + d) % 7;
 }
 
+// Write only the time registers that differ, then verify them
+char rtc_delta;
+
+// Implemented bits of the seven time registers, seconds first.  The
+// MOD-RTC seconds mask includes VL so that a set VL flag forces a write of
+// the seconds register, which clears it.
+static const unsigned char modrtc_mask[7] =
+	{ 0xff, 0x7f, 0x3f, 0x3f, 0x07, 0x9f, 0xff };
+static const unsigned char modrtc2_mask[7] =
+	{ 0x7f, 0x7f, 0x7f, 0x07, 0x3f, 0x9f, 0xff };
+
+// Seconds since the epoch of the seven time registers of device
+static unsigned long delta_epoch(char device, const unsigned char *regs)
+{
+	iso8601_datetime dt;
+
+	dt.sec  = bcd_to_binary(regs[0] & 0x7f);
+	dt.min  = bcd_to_binary(regs[1] & 0x7f);
+	dt.hour = bcd_to_binary(regs[2] & 0x3f);
+	dt.day  = bcd_to_binary(regs[device == 1 ? 3 : 4] & 0x3f);
+	dt.mon  = bcd_to_binary(regs[5] & 0x1f);
+	dt.year = 2000 + bcd_to_binary(regs[6]);
+
+	return iso8601_to_epoch(&dt);
+}
+
+/*
+ * write_delta - write the minimal contiguous range of the seven time
+ * registers starting at reg that differs from want, then read them back.
+ * Returns the number of registers written, or -1.
+ */
+static int write_delta(char device, int addr, unsigned char reg,
+		       const unsigned char *want, const unsigned char *mask,
+		       const char *name)
+{
+	unsigned char snap[7], buffer[8];
+	int first, last, i, res;
+
+	// Snapshot the current registers
+	buffer[0] = reg;
+	res = bus_xfer(addr, buffer, 1, snap, sizeof snap);
+	if (res < 0) {
+		printf("Unable to read time from %s (%d)\r\n", name, res);
+		return -1;
+	}
+
+	first = -1;
+	last = -1;
+	for (i = 0; i < sizeof snap; ++i) {
+		if ((snap[i] ^ want[i]) & mask[i]) {
+			if (first < 0)
+				first = i;
+			last = i;
+		}
+	}
+	if (first < 0)
+		return 0;
+
+	// A seconds rollover between the snapshot and the write would carry
+	// into the registers being written, so include the seconds if close
+	if (first > 0 && (snap[0] & 0x7f) >= 0x58)
+		first = 0;
+
+	buffer[0] = reg + first;
+	for (i = first; i <= last; ++i)
+		buffer[1 + i - first] = want[i];
+	res = bus_xfer(addr, buffer, 1 + last - first + 1, NULL, 0);
+	if (res < 0) {
+		printf("Unable to communicate with %s (%d)\r\n", name, res);
+		return -1;
+	}
+
+	// Read back and verify.  The seconds may have ticked since the write,
+	// carrying into the minutes and beyond at 59, so a difference is
+	// allowed if the whole time read back is one second on, and VL has
+	// been cleared.
+	buffer[0] = reg;
+	res = bus_xfer(addr, buffer, 1, snap, sizeof snap);
+	if (res < 0) {
+		printf("Unable to read time from %s (%d)\r\n", name, res);
+		return -1;
+	}
+
+	for (i = first; i <= last; ++i)
+		if ((snap[i] ^ want[i]) & mask[i])
+			break;
+	if (i <= last && ((snap[0] & mask[0] & 0x80) ||
+	    delta_epoch(device, snap) - delta_epoch(device, want) != 1)) {
+		printf("Verify failed on %s register %d: %02x != %02x\r\n",
+		       name, reg + i, snap[i] & mask[i], want[i] & mask[i]);
+		return -1;
+	}
+
+	if (debug)
+		printf("[delta %d-%d]\r\n", reg + first, reg + last);
+
+	return last - first + 1;
+}
+
+/*
+ * Raw register access for the other features of the chips.  The bus must
+ * already be open.
+ */
+
+int rtc_read_regs(int addr, unsigned char reg, unsigned char *buf,
+		  unsigned int len)
+{
+	return bus_xfer(addr, &reg, 1, buf, len);
+}
+
+int rtc_write_regs(int addr, unsigned char reg, const unsigned char *buf,
+		   unsigned int len)
+{
+	unsigned char buffer[1 + RTC_MAX_REGS];
+	unsigned int i;
+
+	if (len > RTC_MAX_REGS)
+		return -1;
+
+	buffer[0] = reg;
+	for (i = 0; i < len; ++i)
+		buffer[1 + i] = buf[i];
+
+	return bus_xfer(addr, buffer, 1 + len, NULL, 0);
+}
+
+#endif // HWCLOCK_BOOT
+
+#ifndef HWCLOCK_BOOT
+/*
+ * rtc_time_regs - the bytes of a time write to device: the address of the
+ * seconds register, then the registers from seconds to years
+ */
+
+void rtc_time_regs(char device, const iso8601_datetime *dt,
+		   unsigned char *buf)
+{
+	buf[0] = device == 1 ? MOD_RTC_REG_SEC : MOD_RTC2_REG_SEC;
+	buf[1] = binary_to_bcd(dt->sec);
+	buf[2] = binary_to_bcd(dt->min);
+	buf[3] = binary_to_bcd(dt->hour);
+	if (device == 1) {
+		buf[4] = binary_to_bcd(dt->day);
+		buf[5] = dow_from_date(dt->year, dt->mon, dt->day);
+	}
+	else {
+		buf[4] = dow_from_date(dt->year, dt->mon, dt->day);
+		buf[5] = binary_to_bcd(dt->day);
+	}
+	buf[6] = binary_to_bcd(dt->mon);
+	buf[7] = binary_to_bcd(dt->year % 100);
+}
+
 int write_modrtc(iso8601_datetime *dt)
 {
-	unsigned char buffer[8];
-	int wrote;
+	unsigned char buffer[RTC_TIME_BUF];
+	int res;
 
-	buffer[1] = binary_to_bcd(dt->sec);
-	buffer[2] = binary_to_bcd(dt->min);
-	buffer[3] = binary_to_bcd(dt->hour);
-	buffer[4] = binary_to_bcd(dt->day);
-	buffer[5] = dow_from_date(dt->year, dt->mon, dt->day);
-	buffer[6] = binary_to_bcd(dt->mon);
-	buffer[7] = binary_to_bcd(dt->year % 100);
+	rtc_time_regs(1, dt, buffer);
 
 	// Initialise I2C
-	i2c_init(0, 0);
+	bus_open();
 
-	// Set address pointer, the rest of the buffer are the registers
-	// values.
-	buffer[0] = MOD_RTC_REG_SEC;
-	wrote = i2c_ctrl_write(MOD_RTC_I2C_ADDR, buffer, sizeof buffer);
-	if (wrote < sizeof buffer) {
-		printf("Unable to communicate with MOD-RTC (%d)\r\n", wrote);
-		i2c_ctrl_stop(1);
-		return 1;
+	if (rtc_delta) {
+		res = write_delta(1, MOD_RTC_I2C_ADDR, MOD_RTC_REG_SEC,
+				  &buffer[1], modrtc_mask, "MOD-RTC");
+		bus_close();
+		return res < 0 ? -1 : 0;
 	}
 
-	i2c_ctrl_stop(1);
+	res = bus_xfer(MOD_RTC_I2C_ADDR, buffer, sizeof buffer, NULL, 0);
+	bus_close();
+	if (res < 0) {
+		printf("Unable to communicate with MOD-RTC (%d)\r\n", res);
+		return -1;
+	}
 
 	return 0;
 }
 
+#endif // HWCLOCK_BOOT
+
+/*
+ * rtc_read_fast - read the time with the assembly fast path when the
+ * eZ80F92 controller is in use.  Returns -1 to fall back to bus_xfer, after
+ * resetting the controller if the fast path failed part way.
+ */
+
+static int rtc_read_fast(int addr, unsigned char reg, char device,
+			 iso8601_datetime *dt)
+{
+#ifdef HWCLOCK_NO_FAST_READ
+	return -1;
+#else
+	int res;
+
+	// The C path traces each step
+	if (bus != &i2c_bus_reg || debug)
+		return -1;
+
+	PROF_MARK(PROF_OTHER);
+	res = i2c_fast_read_time(addr, reg, device, dt);
+	PROF_MARK(PROF_XFER);
+	if (res == I2C_OK)
+		return 0;
+
+	++bus_recovery.resets;
+	bus->reset();
+	return -1;
+#endif
+}
+
+#ifndef HWCLOCK_MODRTC2_ONLY
 int read_modrtc(iso8601_datetime *dt)
 {
 	unsigned char addrptr;
 	unsigned char buffer[7];
-	int wrote, got;
+	int res;
 
 	// Initialise I2C
-	i2c_init(0, 0);
+	bus_open();
 
-	// Set address pointer to "2"
-	addrptr = 2;
-	wrote = i2c_ctrl_write(MOD_RTC_I2C_ADDR, &addrptr, 1);
-	if (wrote < 1) {
-		printf("Unable to communicate with MOD-RTC (%d)\r\n", wrote);
-		i2c_ctrl_stop(1);
-		return 1;
+	if (rtc_read_fast(MOD_RTC_I2C_ADDR, MOD_RTC_REG_SEC, 1, dt) == 0) {
+		bus_close();
+		return 0;
 	}
 
-	// Read from registers
-	got = i2c_ctrl_read(MOD_RTC_I2C_ADDR, &buffer, sizeof buffer);
+	// Set address pointer to "2" then read from registers
+	addrptr = MOD_RTC_REG_SEC;
+	res = bus_xfer(MOD_RTC_I2C_ADDR, &addrptr, 1, buffer, sizeof buffer);
 
-	// Set STOP condition to release I2C bus
-	i2c_ctrl_stop(1);
+	// Release I2C bus
+	bus_close();
 
 	// Exit if didn't get what we needed
-	if (got < sizeof buffer) {
-		printf("Unable to read time from MOD-RTC (%d)\r\n", got);
-		return 1;
+	if (res < 0) {
+		printf("Unable to read time from MOD-RTC (%d)\r\n", res);
+		return -1;
 	}
 
 	// Convert register values into ISO 8601 date-time structure
@@ -102,65 +290,64 @@ int read_modrtc(iso8601_datetime *dt)
 	return 0;
 }
 
+#endif // HWCLOCK_MODRTC2_ONLY
+
+#ifndef HWCLOCK_BOOT
 int write_modrtc2(iso8601_datetime *dt)
 {
-	unsigned char buffer[8];
-	int wrote;
+	unsigned char buffer[RTC_TIME_BUF];
+	int res;
 
-	buffer[1] = binary_to_bcd(dt->sec);
-	buffer[2] = binary_to_bcd(dt->min);
-	buffer[3] = binary_to_bcd(dt->hour);
-	buffer[4] = dow_from_date(dt->year, dt->mon, dt->day);
-	buffer[5] = binary_to_bcd(dt->day);
-	buffer[6] = binary_to_bcd(dt->mon);
-	buffer[7] = binary_to_bcd(dt->year % 100);
+	rtc_time_regs(2, dt, buffer);
 
 	// Initialise I2C
-	i2c_init(0, 0);
+	bus_open();
 
-	// Set address pointer to "0", the rest of the buffer are the registers
-	// values.
-	buffer[0] = 0;
-	wrote = i2c_ctrl_write(MOD_RTC2_I2C_ADDR, buffer, sizeof buffer);
-	if (wrote < sizeof buffer) {
-		printf("Unable to communicate with MOD-RTC2 (%d)\r\n", wrote);
-		i2c_ctrl_stop(1);
-		return 1;
+	if (rtc_delta) {
+		res = write_delta(2, MOD_RTC2_I2C_ADDR, MOD_RTC2_REG_SEC,
+				  &buffer[1], modrtc2_mask, "MOD-RTC2");
+		bus_close();
+		return res < 0 ? -1 : 0;
 	}
 
-	i2c_ctrl_stop(1);
+	res = bus_xfer(MOD_RTC2_I2C_ADDR, buffer, sizeof buffer, NULL, 0);
+	bus_close();
+	if (res < 0) {
+		printf("Unable to communicate with MOD-RTC2 (%d)\r\n", res);
+		return -1;
+	}
 
 	return 0;
 }
 
+#endif // HWCLOCK_BOOT
+
+#ifndef HWCLOCK_MODRTC_ONLY
 int read_modrtc2(iso8601_datetime *dt)
 {
 	unsigned char addrptr;
 	unsigned char buffer[7];
-	int wrote, got;
+	int res;
 
 	// Initialise I2C
-	i2c_init(0, 0);
+	bus_open();
 
-	// Set address pointer to "0"
-	addrptr = 0;
-	wrote = i2c_ctrl_write(MOD_RTC2_I2C_ADDR, &addrptr, 1);
-	if (wrote < 1) {
-		printf("Unable to communicate with MOD-RTC2 (%d)\r\n", wrote);
-		i2c_ctrl_stop(1);
-		return 1;
+	if (rtc_read_fast(MOD_RTC2_I2C_ADDR, MOD_RTC2_REG_SEC, 2, dt) == 0) {
+		bus_close();
+		return 0;
 	}
 
-	// Read from registers
-	got = i2c_ctrl_read(MOD_RTC2_I2C_ADDR, &buffer, sizeof buffer);
+	// Set address pointer to "0" then read from registers
+	addrptr = MOD_RTC2_REG_SEC;
+	res = bus_xfer(MOD_RTC2_I2C_ADDR, &addrptr, 1, buffer, sizeof buffer);
 
-	// Set STOP condition to release I2C bus
-	i2c_ctrl_stop(1);
+	// Release I2C bus
+	bus_close();
 
 	// Exit if didn't get what we needed
-	if (got < sizeof buffer) {
-		printf("Unable to read time from MOD-RTC2 (%d)\r\n", got);
-		return 1;
+	if (res < 0) {
+		printf("Unable to read time from MOD-RTC2 (%d)\r\n", res);
+		return -1;
 	}
 
 	// Convert register values into ISO 8601 date-time structure
@@ -174,7 +361,24 @@ int read_modrtc2(iso8601_datetime *dt)
 	return 0;
 }
 
-int read_sysrtc(iso8601_datetime *dt)
+#endif // HWCLOCK_MODRTC_ONLY
+
+#ifndef HWCLOCK_BOOT
+
+/*
+ * The system clock is read by asking the VDP to send the ESP32 RTC, which
+ * arrives some time later in the system variables.  The request and the
+ * wait are split so the caller can do other work, such as reading the
+ * hardware clock, during the round trip.  The reply is stamped when
+ * read_sysrtc_ready first sees it, so callers poll that between steps of
+ * their work; a reply arriving during a step is stamped at its end.
+ */
+
+static unsigned long sysrtc_requested;
+static unsigned long sysrtc_arrived;
+static char sysrtc_seen;
+
+void read_sysrtc_request(void)
 {
 	const char vdp_rtc[4] = { 23, 0, VDP_rtc, 0 };
 	struct mos_sysvars *sysvars;
@@ -191,12 +395,36 @@ int read_sysrtc(iso8601_datetime *dt)
 	sysvars->vdp_protocol_flags &= ~ VDPP_FLAG_RTC;
 
 	// Send VDP sequence to request ESP32 RTC data
+	sysrtc_seen = 0;
+	sysrtc_requested = sysvars->clock;
 	mos_write(vdp_rtc, sizeof vdp_rtc);
-	
+}
+
+int read_sysrtc_ready(void)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+
+	if (!sysrtc_seen && (sysvars->vdp_protocol_flags & VDPP_FLAG_RTC)) {
+		sysrtc_arrived = sysvars->clock;
+		sysrtc_seen = 1;
+	}
+
+	return sysrtc_seen;
+}
+
+int read_sysrtc_complete(iso8601_datetime *dt, unsigned long *stamp)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+
 	// Wait for response packet with ESP32 RTC data
-	// TODO: timeout?
-	while (!(sysvars->vdp_protocol_flags & VDPP_FLAG_RTC))
-		;
+	while (!read_sysrtc_ready())
+		if (sysvars->clock - sysrtc_requested > SYSRTC_TIMEOUT_CS)
+			return -1;
+
+	// The ESP32 sampled its clock somewhere during the round trip
+	if (stamp != NULL)
+		*stamp = sysrtc_requested +
+			 (sysrtc_arrived - sysrtc_requested) / 2;
 
 	// Copy the fields into our datetime structure
 	dt->sec  = sysvars->time.second;
@@ -209,6 +437,112 @@ int read_sysrtc(iso8601_datetime *dt)
 	return 0;
 }
 
+int read_sysrtc(iso8601_datetime *dt)
+{
+	read_sysrtc_request();
+	return read_sysrtc_complete(dt, NULL);
+}
+
+/*
+ * read_both - sample both clocks within one VDP round trip, by reading the
+ * hardware clock while waiting for the ESP32 to answer.  Returns -1 if the
+ * hardware clock could not be read and -2 if the system clock could not.
+ */
+
+int read_both(char device, clock_pair *p)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	unsigned long before;
+	int res;
+
+	read_sysrtc_request();
+	before = sysvars->clock;
+	res = device == 1 ? read_modrtc(&p->hc) : read_modrtc2(&p->hc);
+	p->hc_stamp = before + (sysvars->clock - before) / 2;
+	read_sysrtc_ready();
+
+	if (read_sysrtc_complete(&p->sys, &p->sys_stamp) == -1)
+		return -2;
+
+	return res == -1 ? -1 : 0;
+}
+
+/*
+ * read_modrtc2_temp - read the DS3231 temperature in units of 0.25C
+ */
+
+int read_modrtc2_temp(int *quarters)
+{
+	unsigned char buffer[2];
+	int res;
+
+	bus_open();
+	res = rtc_read_regs(MOD_RTC2_I2C_ADDR, MOD_RTC2_REG_TEMP_MSB,
+			    buffer, sizeof buffer);
+	bus_close();
+	if (res < 0)
+		return -1;
+
+	// Two's complement integer part, then quarters in bits 7:6
+	*quarters = (signed char)buffer[0] * 4 + (buffer[1] >> 6);
+
+	return 0;
+}
+
+/*
+ * rtc_health - the RTC_HEALTH_* flags of a hardware clock, each of which
+ * means its time cannot be trusted, or -1 if it could not be read
+ */
+
+int rtc_health(char device)
+{
+	unsigned char reg;
+	int res;
+
+	bus_open();
+	if (device == 1)
+		res = rtc_read_regs(MOD_RTC_I2C_ADDR, MOD_RTC_REG_SEC, &reg, 1);
+	else
+		res = rtc_read_regs(MOD_RTC2_I2C_ADDR, MOD_RTC2_REG_CTRL2,
+				    &reg, 1);
+	bus_close();
+	if (res < 0)
+		return -1;
+
+	if (device == 1)
+		return reg & MOD_RTC_SEC_VL ? RTC_HEALTH_VL : 0;
+	else
+		return reg & MOD_RTC2_STAT_OSF ? RTC_HEALTH_OSF : 0;
+}
+
+/*
+ * rtc_clear_health - clear the flags after the time has been set.  Writing
+ * the MOD-RTC seconds register already clears VL; the MOD-RTC2 OSF flag
+ * must be cleared by hand.
+ */
+
+int rtc_clear_health(char device)
+{
+	unsigned char reg;
+	int res;
+
+	if (device == 1)
+		return 0;
+
+	bus_open();
+	res = rtc_read_regs(MOD_RTC2_I2C_ADDR, MOD_RTC2_REG_CTRL2, &reg, 1);
+	if (res == 0) {
+		reg &= ~MOD_RTC2_STAT_OSF;
+		res = rtc_write_regs(MOD_RTC2_I2C_ADDR, MOD_RTC2_REG_CTRL2,
+				     &reg, 1);
+	}
+	bus_close();
+
+	return res < 0 ? -1 : 0;
+}
+
+#endif // HWCLOCK_BOOT
+
 int write_sysrtc(const iso8601_datetime *dt)
 {
 	unsigned char mosrtc[MOS_RTC_WRITE_LEN];
@@ -220,7 +554,9 @@ int write_sysrtc(const iso8601_datetime *dt)
 	mosrtc[4] = dt->min;
 	mosrtc[5] = dt->sec;
 
+	PROF_MARK(PROF_OTHER);
 	mos_setrtc(mosrtc);
+	PROF_MARK(PROF_SETRTC);
 
 	return 0;
 }
@@ -66,6 +66,71 @@
 #define MOD_RTC2_REG_TEMP_MSB	17
 #define MOD_RTC2_REG_TEMP_LSB	18
 
+// MOD-RTC CLKOUT control: enabled, 1Hz
+#define MOD_RTC_CLKOUT_FE	(1 << 7)
+#define MOD_RTC_CLKOUT_1HZ	0x03
+
+// MOD-RTC control/status 1: stop the clock and reset its prescaler
+#define MOD_RTC_CTRL1_STOP	(1 << 5)
+
+// MOD-RTC control/status 2 register bits
+#define MOD_RTC_CTRL2_TI_TP	(1 << 4)
+#define MOD_RTC_CTRL2_AF	(1 << 3)
+#define MOD_RTC_CTRL2_TF	(1 << 2)
+#define MOD_RTC_CTRL2_AIE	(1 << 1)
+#define MOD_RTC_CTRL2_TIE	(1 << 0)
+
+// MOD-RTC alarm registers: set to leave that field out of the match
+#define MOD_RTC_AL_DISABLE	(1 << 7)
+
+// MOD-RTC countdown timer control: enabled, 1Hz source
+#define MOD_RTC_TIMER_TE	(1 << 7)
+#define MOD_RTC_TIMER_1HZ	0x02
+
+// MOD-RTC2 control register bits
+#define MOD_RTC2_CTRL_CONV	(1 << 5)
+#define MOD_RTC2_CTRL_RS2	(1 << 4)
+#define MOD_RTC2_CTRL_RS1	(1 << 3)
+#define MOD_RTC2_CTRL_INTCN	(1 << 2)
+#define MOD_RTC2_CTRL_A2IE	(1 << 1)
+#define MOD_RTC2_CTRL_A1IE	(1 << 0)
+
+// MOD-RTC2 status register bits
+#define MOD_RTC2_STAT_OSF	(1 << 7)
+#define MOD_RTC2_STAT_BSY	(1 << 2)
+#define MOD_RTC2_STAT_A2F	(1 << 1)
+#define MOD_RTC2_STAT_A1F	(1 << 0)
+
+// MOD-RTC2 alarm registers: leave that field out of the match, and match
+// the day of the week rather than the date
+#define MOD_RTC2_AL_MASK	(1 << 7)
+#define MOD_RTC2_AL_DY		(1 << 6)
+
+// MOD-RTC seconds register: clock integrity is not guaranteed
+#define MOD_RTC_SEC_VL		(1 << 7)
+
+// Health flags returned by rtc_health
+#define RTC_HEALTH_VL		0x01	// MOD-RTC voltage low
+#define RTC_HEALTH_OSF		0x02	// MOD-RTC2 oscillator stopped
+
+// Most registers transferred by rtc_write_regs
+#define RTC_MAX_REGS		19
+
+
+// Set to make write_modrtc/write_modrtc2 write only the registers that
+// differ from the chip's current time, and verify them afterwards
+extern char rtc_delta;
+
+int rtc_read_regs(int addr, unsigned char reg, unsigned char *buf,
+		  unsigned int len);
+int rtc_write_regs(int addr, unsigned char reg, const unsigned char *buf,
+		   unsigned int len);
+
+// Bytes of a time write: the register address, then seconds to years
+#define RTC_TIME_BUF		8
+
+void rtc_time_regs(char device, const iso8601_datetime *dt,
+		   unsigned char *buf);
 
 int write_modrtc(iso8601_datetime *dt);
 int read_modrtc(iso8601_datetime *dt);
@@ -73,7 +138,26 @@ int read_modrtc(iso8601_datetime *dt);
 int write_modrtc2(iso8601_datetime *dt);
 int read_modrtc2(iso8601_datetime *dt);
 
+// Both clocks sampled together, with the MOS clock at each sample
+typedef struct clock_pair {
+	iso8601_datetime	hc;
+	iso8601_datetime	sys;
+	unsigned long		hc_stamp;
+	unsigned long		sys_stamp;
+} clock_pair;
+
+// Longest wait for the VDP to answer a system clock request
+#define SYSRTC_TIMEOUT_CS	100
+
 int write_sysrtc(const iso8601_datetime *dt);
 int read_sysrtc(iso8601_datetime *dt);
+void read_sysrtc_request(void);
+int read_sysrtc_ready(void);
+int read_sysrtc_complete(iso8601_datetime *dt, unsigned long *stamp);
+int read_both(char device, clock_pair *p);
+
+int read_modrtc2_temp(int *quarters);
+int rtc_health(char device);
+int rtc_clear_health(char device);
 
 #endif // RTC_H_
@@ -0,0 +1,241 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  select.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Read every clock, choose the one most likely to be right, and set the
+ *  others from it.
+ *
+ *  A clock is only a candidate if it is healthy: no VL or OSF flag, and a
+ *  plausible year.  Among the candidates, the one that agrees with the
+ *  most others wins, so a single wrong clock is outvoted; ties go to the
+ *  clock with the least drift, from the stored drift settings or else the
+ *  part's tolerance.
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+
+#include "rtc.h"
+#include "kv.h"
+#include "tz.h"
+#include "select.h"
+#include "mos-interface.h"
+
+extern char debug;
+extern char local;
+
+typedef struct clock_source {
+	const char		*name;
+	char			present;
+	unsigned char		health;
+	iso8601_datetime	dt;	// UTC
+	unsigned long		epoch;
+	unsigned long		stamp;	// MOS clock at the sample
+	long			drift;	// ppb
+} clock_source;
+
+static clock_source sources[SELECT_SOURCES] = {
+	{ "System Clock" },
+	{ "MOD-RTC" },
+	{ "MOD-RTC2" },
+};
+
+// Sampled offset of clock a from clock b, centiseconds, saturating
+static long offset_cs(const clock_source *a, const clock_source *b)
+{
+	long secs = a->epoch - b->epoch;
+
+	if (secs > 1000000L)
+		return 100000000L;
+	if (secs < -1000000L)
+		return -100000000L;
+
+	return secs * 100 - (long)(a->stamp - b->stamp);
+}
+
+static long abs_long(long v)
+{
+	return v < 0 ? -v : v;
+}
+
+static void select_sample(void)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	clock_source *s;
+	unsigned long before;
+	long drift;
+	int dev, res;
+
+	// Read the hardware clocks during the VDP round trip
+	read_sysrtc_request();
+	for (dev = SELECT_MODRTC; dev <= SELECT_MODRTC2; ++dev) {
+		s = &sources[dev];
+		before = sysvars->clock;
+		res = dev == SELECT_MODRTC ? read_modrtc(&s->dt)
+					   : read_modrtc2(&s->dt);
+		s->stamp = before + (sysvars->clock - before) / 2;
+		read_sysrtc_ready();
+		s->present = res == 0;
+		if (s->present) {
+			res = rtc_health(dev);
+			s->health = res < 0 ? 0 : res;
+			read_sysrtc_ready();
+		}
+	}
+
+	s = &sources[SELECT_SYS];
+	s->present = read_sysrtc_complete(&s->dt, &s->stamp) == 0;
+	s->health = 0;
+	if (s->present && local)
+		epoch_to_iso8601(tz_from_local(iso8601_to_epoch(&s->dt), NULL),
+				 &s->dt);
+
+	sources[SELECT_SYS].drift = SELECT_DRIFT_SYS;
+	sources[SELECT_MODRTC].drift =
+		kv_get_num(KV_KEY_DRIFT, &drift) == 0 ? drift
+						      : SELECT_DRIFT_MODRTC;
+	sources[SELECT_MODRTC2].drift =
+		kv_get_num(KV_KEY_DRIFT2, &drift) == 0 ? drift
+						       : SELECT_DRIFT_MODRTC2;
+
+	for (dev = 0; dev < SELECT_SOURCES; ++dev) {
+		s = &sources[dev];
+		if (!s->present)
+			continue;
+		s->epoch = iso8601_to_epoch(&s->dt);
+		if (s->dt.year < SELECT_MIN_YEAR)
+			s->health |= SELECT_IMPLAUSIBLE;
+	}
+}
+
+// The healthy source agreeing with most others, least drift first, or -1
+static int select_best(void)
+{
+	int i, j, votes, best = -1, best_votes = -1;
+
+	for (i = 0; i < SELECT_SOURCES; ++i) {
+		if (!sources[i].present || sources[i].health)
+			continue;
+
+		votes = 0;
+		for (j = 0; j < SELECT_SOURCES; ++j)
+			if (j != i && sources[j].present && !sources[j].health &&
+			    abs_long(offset_cs(&sources[j], &sources[i])) <=
+			    SELECT_AGREE_CS)
+				++votes;
+
+		if (votes > best_votes ||
+		    (votes == best_votes &&
+		     abs_long(sources[i].drift) < abs_long(sources[best].drift))) {
+			best = i;
+			best_votes = votes;
+		}
+	}
+
+	return best;
+}
+
+static const char *select_status(int i, int best)
+{
+	const clock_source *s = &sources[i];
+
+	if (!s->present)
+		return "absent";
+	if (i == best)
+		return "selected";
+	if (s->health & RTC_HEALTH_VL)
+		return "VL set";
+	if (s->health & RTC_HEALTH_OSF)
+		return "OSF set";
+	if (s->health & SELECT_IMPLAUSIBLE)
+		return "implausible";
+	if (abs_long(offset_cs(s, &sources[best])) > SELECT_AGREE_CS)
+		return "outlier";
+	return "agrees";
+}
+
+static int select_set(int i, unsigned long epoch)
+{
+	iso8601_datetime dt;
+	int res;
+
+	if (i == SELECT_SYS) {
+		if (local)
+			epoch = tz_to_local(epoch, NULL);
+		epoch_to_iso8601(epoch, &dt);
+		return write_sysrtc(&dt);
+	}
+
+	epoch_to_iso8601(epoch, &dt);
+	res = i == SELECT_MODRTC ? write_modrtc(&dt) : write_modrtc2(&dt);
+	if (res == 0 && sources[i].health)
+		res = rtc_clear_health(i);
+
+	return res;
+}
+
+/*
+ * select_clocks - sample every clock, report on each, and set those that
+ * differ from the best.  Returns the source chosen, or -1 if no clock can
+ * be trusted, with the time it set in *synced.
+ */
+
+int select_clocks(unsigned long *synced)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	char buf[ISO8601_DT_LEN + 1];
+	unsigned long epoch;
+	clock_source *s;
+	long off, last;
+	int i, best;
+
+	select_sample();
+	best = select_best();
+
+	for (i = 0; i < SELECT_SOURCES; ++i) {
+		s = &sources[i];
+		if (!s->present) {
+			printf("%-13s absent\r\n", s->name);
+			continue;
+		}
+		iso8601_to_str(&s->dt, buf, sizeof buf);
+		off = best < 0 ? 0 : offset_cs(s, &sources[best]);
+		printf("%-13s %s %8ld cs  %6ld ppb  %s\r\n", s->name, buf, off,
+		       s->drift, select_status(i, best));
+	}
+
+	if (best < 0) {
+		printf("No clock can be trusted\r\n");
+		return -1;
+	}
+
+	// Drift accumulated since the clocks were last brought together
+	if (kv_get_num(KV_KEY_SYNCED, &last) == 0 &&
+	    (long)(sources[best].epoch - last) > 0)
+		printf("Estimated error of %s: %ld ms\r\n", sources[best].name,
+		       (long)(sources[best].epoch - last) / 1000 *
+		       abs_long(sources[best].drift) / 1000);
+
+	// Assume the selected clock was sampled half way through its second
+	for (i = 0; i < SELECT_SOURCES; ++i) {
+		s = &sources[i];
+		if (i == best || !s->present)
+			continue;
+		if (!s->health &&
+		    abs_long(offset_cs(s, &sources[best])) < SELECT_SET_CS)
+			continue;
+
+		epoch = sources[best].epoch +
+			(sysvars->clock - sources[best].stamp + 50) / 100;
+		if (select_set(i, epoch) < 0)
+			printf("Unable to set %s\r\n", s->name);
+		else
+			printf("Set %s from %s\r\n", s->name,
+			       sources[best].name);
+	}
+
+	*synced = sources[best].epoch;
+	return best;
+}
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  select.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef SELECT_H_
+#define SELECT_H_
+
+// Sources, numbered as the -1 and -2 devices
+#define SELECT_SYS		0
+#define SELECT_MODRTC		1
+#define SELECT_MODRTC2		2
+#define SELECT_SOURCES		3
+
+// Clocks further apart than this disagree, centiseconds
+#define SELECT_AGREE_CS		200
+
+// A clock this far from the selected one is set from it, centiseconds
+#define SELECT_SET_CS		100
+
+// Earliest plausible year; a clock that lost power reads earlier
+#define SELECT_MIN_YEAR		2023
+
+// Health flag, in addition to RTC_HEALTH_*
+#define SELECT_IMPLAUSIBLE	0x80
+
+// Drift assumed without a measurement, ppb: the crystal tolerances of the
+// ESP32, the PCF8563 on MOD-RTC and the TCXO of the DS3231 on MOD-RTC2
+#define SELECT_DRIFT_SYS	50000L
+#define SELECT_DRIFT_MODRTC	20000L
+#define SELECT_DRIFT_MODRTC2	2000L
+
+int select_clocks(unsigned long *synced);
+
+#endif // SELECT_H_
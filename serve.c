@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  serve.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Answer time service requests on UART1 until a key is pressed.  Times
+ *  come from hwclock_read, which interpolates from the MOS clock, so most
+ *  replies need no I2C transaction at all.
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+
+#include "hwclock.h"
+#include "proto.h"
+#include "uart.h"
+#include "serve.h"
+#include "mos-interface.h"
+
+extern char debug;
+
+int serve(char device, unsigned long baud)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	unsigned char reply[PROTO_REP_LEN];
+	unsigned long errors = 0;
+	proto_parser p;
+	hwclock_time t;
+	unsigned char status;
+	int c;
+
+	if (hwclock_open(device) < 0)
+		return -1;
+	if (uart_open(baud) < 0) {
+		printf("Invalid baud rate: %lu\r\n", baud);
+		return -1;
+	}
+
+	printf("Serving time on UART1 at %lu baud, press a key to stop\r\n",
+	       baud);
+
+	proto_init(&p);
+	sysvars->keyascii = 0;
+	while (sysvars->keyascii == 0) {
+		c = uart_getc();
+		if (c < 0 || !proto_feed(&p, c))
+			continue;
+
+		switch (proto_cmd(&p)) {
+			case PROTO_CMD_PING:
+				status = PROTO_OK;
+				break;
+			case PROTO_CMD_TIME:
+				status = hwclock_read(&t) < 0 ?
+					 PROTO_ERR_CLOCK : PROTO_OK;
+				break;
+			default:
+				status = PROTO_ERR_CMD;
+				break;
+		}
+		if (status != PROTO_OK)
+			++errors;
+
+		uart_write(reply, proto_reply(&p, status, &t, reply));
+	}
+	sysvars->keyascii = 0;
+
+	uart_close();
+
+	printf("%lu requests, %lu errors, %lu bytes discarded, "
+	       "%u overruns\r\n", p.requests, errors, p.bad, uart_overruns());
+
+	return 0;
+}
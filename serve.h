@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  serve.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef SERVE_H_
+#define SERVE_H_
+
+// Default UART1 rate of the time service
+#define SERVE_DEFAULT_BAUD	115200
+
+int serve(char device, unsigned long baud);
+
+#endif // SERVE_H_
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  temp.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  On-demand DS3231 temperature conversion.  The chip only updates its
+ *  temperature registers every 64 seconds by itself; setting CONV forces a
+ *  conversion.  temp_start and temp_poll split the conversion so the
+ *  caller can do other work while it runs.
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+
+#include "bus.h"
+#include "rtc.h"
+#include "temp.h"
+#include "mos-interface.h"
+
+static unsigned long temp_started;
+
+// Read the control and status registers, which are adjacent
+static int temp_ctrl_stat(unsigned char *regs)
+{
+	int res;
+
+	bus_open();
+	res = rtc_read_regs(MOD_RTC2_I2C_ADDR, MOD_RTC2_REG_CTRL, regs, 2);
+	bus_close();
+
+	return res;
+}
+
+/*
+ * temp_start - force a conversion, unless one is already running
+ */
+
+int temp_start(void)
+{
+	unsigned char regs[2];
+	int res;
+
+	temp_started = mos_sysvars()->clock;
+
+	if (temp_ctrl_stat(regs) < 0)
+		return -1;
+
+	// An automatic conversion is in progress, so just wait for that
+	if ((regs[0] & MOD_RTC2_CTRL_CONV) || (regs[1] & MOD_RTC2_STAT_BSY))
+		return 0;
+
+	regs[0] |= MOD_RTC2_CTRL_CONV;
+	bus_open();
+	res = rtc_write_regs(MOD_RTC2_I2C_ADDR, MOD_RTC2_REG_CTRL, regs, 1);
+	bus_close();
+
+	return res < 0 ? -1 : 0;
+}
+
+/*
+ * temp_poll - TEMP_DONE when the conversion has finished, TEMP_BUSY while
+ * it is running, or -1 on error or if the deadline has passed
+ */
+
+int temp_poll(void)
+{
+	unsigned char regs[2];
+
+	if (temp_ctrl_stat(regs) < 0)
+		return -1;
+
+	if (!(regs[0] & MOD_RTC2_CTRL_CONV) && !(regs[1] & MOD_RTC2_STAT_BSY))
+		return TEMP_DONE;
+
+	if (mos_sysvars()->clock - temp_started > TEMP_DEADLINE_CS)
+		return -1;
+
+	return TEMP_BUSY;
+}
+
+/*
+ * temp_read - convert and read, in units of 0.25C
+ */
+
+int temp_read(int *quarters)
+{
+	int res;
+
+	if (temp_start() < 0)
+		return -1;
+
+	while ((res = temp_poll()) == TEMP_BUSY)
+		;
+	if (res < 0)
+		return -1;
+
+	return read_modrtc2_temp(quarters);
+}
+
+int temp_show(void)
+{
+	int q;
+
+	if (temp_read(&q) < 0) {
+		printf("Unable to read temperature from MOD-RTC2\r\n");
+		return -1;
+	}
+
+	printf("%s%d.%02d C\r\n", q < 0 ? "-" : "",
+	       (q < 0 ? -q : q) / 4, (q < 0 ? -q : q) % 4 * 25);
+
+	return 0;
+}
@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  temp.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef TEMP_H_
+#define TEMP_H_
+
+// A conversion takes 125ms typically and 200ms at most
+#define TEMP_DEADLINE_CS	30
+
+#define TEMP_BUSY		0
+#define TEMP_DONE		1
+
+int temp_start(void);
+int temp_poll(void);
+int temp_read(int *quarters);
+int temp_show(void);
+
+#endif // TEMP_H_
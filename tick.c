@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  tick.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Wait for the hardware clock's second boundary, either from its 1Hz
+ *  output on a GPIO pin, or failing that by polling the seconds register.
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+
+#include "bus.h"
+#include "rtc.h"
+#include "tick.h"
+#include "mos-interface.h"
+
+extern char debug;
+
+static char tick_device;
+static char tick_pin;			// The pin has been seen to toggle
+static unsigned char tick_saved;	// Control register before tick_open
+static unsigned char tick_last_sec;	// For register polling
+
+static int tick_addr(void)
+{
+	return tick_device == 1 ? MOD_RTC_I2C_ADDR : MOD_RTC2_I2C_ADDR;
+}
+
+static unsigned char tick_ctrl_reg(void)
+{
+	return tick_device == 1 ? MOD_RTC_REG_CLK_CTRL : MOD_RTC2_REG_CTRL;
+}
+
+static int tick_read_sec(unsigned char *sec)
+{
+	unsigned char reg;
+	int res;
+
+	reg = tick_device == 1 ? MOD_RTC_REG_SEC : MOD_RTC2_REG_SEC;
+	bus_open();
+	res = rtc_read_regs(tick_addr(), reg, sec, 1);
+	bus_close();
+	*sec &= 0x7f;
+
+	return res;
+}
+
+/*
+ * tick_open - switch the chip's output to 1Hz and make the pin an input
+ */
+
+int tick_open(char device)
+{
+	unsigned char ctrl;
+	int res;
+
+	tick_device = device;
+	tick_pin = 1;
+
+	// GPIO mode 2: input
+	PC_DDR  |= TICK_PIN;
+	PC_ALT1 &= ~TICK_PIN;
+	PC_ALT2 &= ~TICK_PIN;
+
+	bus_open();
+	res = rtc_read_regs(tick_addr(), tick_ctrl_reg(), &tick_saved, 1);
+	if (res == 0) {
+		if (device == 1)
+			ctrl = MOD_RTC_CLKOUT_FE | MOD_RTC_CLKOUT_1HZ;
+		else
+			ctrl = tick_saved & ~(MOD_RTC2_CTRL_INTCN |
+					      MOD_RTC2_CTRL_RS2 |
+					      MOD_RTC2_CTRL_RS1);
+		res = rtc_write_regs(tick_addr(), tick_ctrl_reg(), &ctrl, 1);
+	}
+	bus_close();
+
+	if (res < 0)
+		return -1;
+
+	return tick_read_sec(&tick_last_sec);
+}
+
+void tick_close(void)
+{
+	bus_open();
+	rtc_write_regs(tick_addr(), tick_ctrl_reg(), &tick_saved, 1);
+	bus_close();
+}
+
+int tick_pin_level(void)
+{
+	return (PC_DR & TICK_PIN) != 0;
+}
+
+int tick_using_pin(void)
+{
+	return tick_pin;
+}
+
+/*
+ * tick_wait_edge - wait for a falling edge on the pin, which is when the
+ * DS3231 increments its seconds.  Returns -1 on timeout.
+ */
+
+int tick_wait_edge(unsigned int timeout)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	unsigned long start = sysvars->clock;
+
+	while (!tick_pin_level())
+		if (sysvars->clock - start > timeout)
+			return -1;
+	while (tick_pin_level())
+		if (sysvars->clock - start > timeout)
+			return -1;
+
+	return 0;
+}
+
+// Poll the seconds register until it changes
+static int tick_poll(void)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	unsigned long last;
+	unsigned char sec;
+
+	for (;;) {
+		if (tick_read_sec(&sec) < 0)
+			return -1;
+		if (sec != tick_last_sec)
+			break;
+
+		last = sysvars->clock;
+		while (sysvars->clock - last < TICK_POLL_CS)
+			;
+	}
+	tick_last_sec = sec;
+
+	return 0;
+}
+
+/*
+ * tick_wait - wait for the next second boundary.  Falls back to polling
+ * the seconds register for good if the pin never toggles.
+ */
+
+int tick_wait(void)
+{
+	unsigned char sec;
+
+	if (tick_pin) {
+		if (tick_wait_edge(TICK_EDGE_TIMEOUT) == 0) {
+			// The PCF8563 edge is not tied to its seconds
+			// increment, so confirm the register has moved on
+			if (tick_read_sec(&sec) == 0 && sec != tick_last_sec) {
+				tick_last_sec = sec;
+				return 0;
+			}
+		}
+		else {
+			if (debug)
+				printf("[no 1Hz edge, polling]\r\n");
+			tick_pin = 0;
+		}
+	}
+
+	return tick_poll();
+}
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  tick.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef TICK_H_
+#define TICK_H_
+
+/*
+ * GPIO pin (Port C, on the Agon GPIO header) wired to the DS3231 SQW or
+ * PCF8563 CLKOUT output.  Both are open-drain, so the pin needs a pull-up.
+ * PC5 keeps clear of UART1 on PC0 and PC1 and the PPS input on PC4.
+ */
+#define TICK_PIN		(1 << 5)
+
+// Longest wait for an edge before giving up on the pin, centiseconds
+#define TICK_EDGE_TIMEOUT	120
+
+// Interval between seconds register polls when there is no pin
+#define TICK_POLL_CS		2
+
+int tick_open(char device);
+void tick_close(void);
+int tick_pin_level(void);
+int tick_wait_edge(unsigned int timeout);
+int tick_wait(void);
+int tick_using_pin(void);
+
+#endif // TICK_H_
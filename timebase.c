@@ -0,0 +1,363 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  timebase.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  A microsecond timebase: the PRT count, with its rate fitted against
+ *  the hardware clock's 1Hz output.
+ *
+ *  Each falling edge on the tick pin is latched as a count, but only if
+ *  the pin was polled shortly before, since an edge seen late would skew
+ *  the fit.  Shortly is measured, not assumed: within TIMEBASE_LATE_FACTOR
+ *  times the shortest gap between polls so far, the cost of
+ *  timebase_wait_edge's loop.  That loop skips an edge it sees late and
+ *  waits for the next.  The
+ *  rate is the count between the oldest and newest of the last
+ *  TIMEBASE_FIT latched edges over the seconds between them, so it follows
+ *  the crystals as they warm up.  Times are the seconds since the first
+ *  edge plus the count since the latest one, scaled by the rate.
+ *
+ *  Call timebase_poll, or one of the reads, at least once an hour, before
+ *  the count since the latest edge overflows.
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+
+#include "rtc.h"
+#include "tick.h"
+#include "prt.h"
+#include "timebase.h"
+#include "mos-interface.h"
+
+extern char debug;
+
+// Multiple of the shortest gap between polls beyond which an edge is not
+// latched, leaving room for the polls that also carry the MOS clock
+#define TIMEBASE_LATE_FACTOR	2
+
+// Largest departure from whole seconds allowed between latched edges
+#define TIMEBASE_SLIP_TICKS	(PRT_HZ / 100)
+
+static prt_mark tb_mark;
+static unsigned long tb_ticks;		// Count since open, modulo 2^32
+static unsigned long tb_gap;		// Ticks between the last two polls
+static unsigned long tb_gap_min;	// Shortest gap since open
+static char tb_level;
+
+static unsigned long tb_edge_ticks[TIMEBASE_FIT];	// tb_ticks at edges
+static unsigned long tb_edge_sec[TIMEBASE_FIT];		// Seconds since first
+static unsigned char tb_head;		// Latest latched edge
+static unsigned char tb_edges;		// Latched edges held
+static unsigned long tb_hz;		// Fitted ticks per second
+static long tb_residual;		// Latest edge against the fit, ticks
+
+static unsigned long tb_first;		// tb_ticks at the first edge
+
+static unsigned long tb_epoch;		// Second that started at the first
+static unsigned long tb_lead_us;	// edge, or this long after it
+
+// Latch an edge at the current count.  Returns 1 if it was used.
+static int tb_latch(void)
+{
+	unsigned long since, secs, expect;
+	unsigned char prev, oldest;
+
+	if (tb_gap > tb_gap_min * TIMEBASE_LATE_FACTOR)
+		return 0;
+
+	if (tb_edges == 0) {
+		tb_head = 0;
+		tb_first = tb_ticks;
+		tb_edge_ticks[0] = tb_ticks;
+		tb_edge_sec[0] = 0;
+		tb_edges = 1;
+		return 1;
+	}
+
+	// Whole seconds since the latest edge, ignoring noise on the pin
+	since = tb_ticks - tb_edge_ticks[tb_head];
+	secs = (since + tb_hz / 2) / tb_hz;
+	expect = secs * tb_hz;
+	if (secs == 0 || (since > expect ? since - expect : expect - since) >
+			 TIMEBASE_SLIP_TICKS)
+		return 0;
+	tb_residual = (long)(since - expect);
+
+	prev = tb_head;
+	tb_head = (tb_head + 1) % TIMEBASE_FIT;
+	tb_edge_ticks[tb_head] = tb_ticks;
+	tb_edge_sec[tb_head] = tb_edge_sec[prev] + secs;
+	if (tb_edges < TIMEBASE_FIT)
+		++tb_edges;
+
+	oldest = (tb_head + 1 + TIMEBASE_FIT - tb_edges) % TIMEBASE_FIT;
+	secs = tb_edge_sec[tb_head] - tb_edge_sec[oldest];
+	tb_hz = (tb_edge_ticks[tb_head] - tb_edge_ticks[oldest] + secs / 2) /
+		secs;
+
+	return 1;
+}
+
+/*
+ * timebase_poll - bring the count up to date and look for an edge.
+ * Returns 1 if an edge was latched.
+ */
+
+int timebase_poll(void)
+{
+	char level;
+
+	level = tick_pin_level();
+	tb_gap = prt_elapsed(&tb_mark);
+	tb_ticks += tb_gap;
+	if (tb_gap < tb_gap_min)
+		tb_gap_min = tb_gap;
+
+	if (level == tb_level)
+		return 0;
+	tb_level = level;
+
+	// The DS3231 increments its seconds on the falling edge
+	return level ? 0 : tb_latch();
+}
+
+// Poll until an edge is latched, or give up after TIMEBASE_EDGE_TIMEOUT.
+// An edge that is rejected, say after an interrupt burst held up a poll,
+// is passed over for the next; tb_latch allows for the missing second.
+int timebase_wait_edge(void)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	unsigned long start = sysvars->clock;
+
+	while (!timebase_poll())
+		if (sysvars->clock - start > TIMEBASE_EDGE_TIMEOUT)
+			return -1;
+
+	return 0;
+}
+
+unsigned long timebase_hz(void)
+{
+	return tb_hz;
+}
+
+// Edges the rate is fitted over so far; below 2 it is the nominal rate
+unsigned char timebase_fitted(void)
+{
+	return tb_edges;
+}
+
+long timebase_residual(void)
+{
+	return tb_residual;
+}
+
+// Time since the first edge
+void timebase_mono(timebase_time *t)
+{
+	unsigned long since, rem;
+
+	timebase_poll();
+
+	since = tb_ticks - tb_edge_ticks[tb_head];
+	rem = since % tb_hz;
+	t->sec = tb_edge_sec[tb_head] + since / tb_hz;
+
+	// rem * 1000000 / tb_hz, in two steps that fit in 32 bits
+	t->usec = rem * 1000 / tb_hz * 1000 +
+		  rem * 1000 % tb_hz * 1000 / tb_hz;
+}
+
+// UTC, from the hardware clock's time at the first edge
+void timebase_wall(timebase_time *t)
+{
+	timebase_mono(t);
+
+	t->sec += tb_epoch;
+	if (t->usec >= tb_lead_us)
+		t->usec -= tb_lead_us;
+	else {
+		t->usec += 1000000L - tb_lead_us;
+		--t->sec;
+	}
+}
+
+static int tb_read(char device, unsigned long *epoch)
+{
+	iso8601_datetime dt;
+
+	if ((device == 1 ? read_modrtc(&dt) : read_modrtc2(&dt)) == -1)
+		return -1;
+
+	*epoch = iso8601_to_epoch(&dt);
+
+	return 0;
+}
+
+/*
+ * tb_find_lead - the PCF8563's 1Hz output is not tied to its seconds
+ * increment, so time the increment from the first edge by polling
+ */
+
+static int tb_find_lead(char device)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	unsigned long start = sysvars->clock;
+	unsigned long epoch;
+	timebase_time t, before;
+
+	if (tb_read(device, &tb_epoch) < 0)
+		return -1;
+
+	do {
+		timebase_mono(&before);
+		if (tb_read(device, &epoch) < 0)
+			return -1;
+		timebase_mono(&t);
+		if (sysvars->clock - start > TICK_EDGE_TIMEOUT)
+			return -1;
+	} while (epoch == tb_epoch);
+
+	// The increment was during the last read, which took well under a
+	// second
+	if (t.sec != before.sec)
+		t.usec += 1000000L;
+	tb_lead_us = before.usec + (t.usec - before.usec) / 2;
+	tb_epoch = epoch - before.sec;
+	if (tb_lead_us >= 1000000L) {
+		tb_lead_us -= 1000000L;
+		--tb_epoch;
+	}
+	if (debug)
+		printf("[1Hz edge leads the seconds by %lu us]\r\n",
+		       tb_lead_us);
+
+	return 0;
+}
+
+/*
+ * timebase_open - switch the hardware clock to 1Hz, start the count and
+ * latch the first edge
+ */
+
+int timebase_open(char device)
+{
+	if (tick_open(device) < 0)
+		return -1;
+
+	prt_open();
+	prt_mark_now(&tb_mark);
+	tb_ticks = 0;
+	tb_gap = 0;
+	tb_gap_min = ~0UL;
+	tb_edges = 0;
+	tb_hz = PRT_HZ;
+	tb_residual = 0;
+	tb_lead_us = 0;
+	tb_level = tick_pin_level();
+
+	if (timebase_wait_edge() < 0) {
+		tick_close();
+		return -1;
+	}
+
+	// The DS3231 starts each second on the falling edge
+	if (device == 1 ? tb_find_lead(device) : tb_read(device, &tb_epoch)) {
+		tick_close();
+		return -1;
+	}
+
+	return 0;
+}
+
+void timebase_close(void)
+{
+	tick_close();
+}
+
+/*
+ * timebase_show - show the fitted rate at each edge until a key is pressed
+ */
+
+int timebase_show(char device)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	char buf[ISO8601_DT_LEN + 1];
+	iso8601_datetime dt;
+	timebase_time t;
+
+	if (timebase_open(device) < 0) {
+		printf("No 1Hz edges on the tick pin\r\n");
+		return -1;
+	}
+
+	printf("Time                       Hz       ppm  Residual us\r\n");
+
+	sysvars->keyascii = 0;
+	while (sysvars->keyascii == 0) {
+		if (timebase_wait_edge() < 0) {
+			printf("Lost the 1Hz edges\r\n");
+			break;
+		}
+		timebase_wall(&t);
+		epoch_to_iso8601(t.sec, &dt);
+		iso8601_to_str(&dt, buf, sizeof buf);
+		printf("%s.%06lu %8lu %8ld %8ld\r\n", buf, t.usec, tb_hz,
+		       (long)(tb_hz - PRT_HZ) * 1000000L / (long)PRT_HZ,
+		       tb_residual * 125 / 144);
+	}
+	sysvars->keyascii = 0;
+
+	timebase_close();
+
+	return 0;
+}
+
+/*
+ * timebase_calibrate - count the PRT from the first edge to the first one
+ * at least seconds later, and return the eZ80 crystal's error against the
+ * hardware clock in ppb
+ */
+
+int timebase_calibrate(char device, unsigned int seconds, long *ppb)
+{
+	unsigned long ticks, secs;
+	long excess;
+	unsigned char lost = 0;
+
+	if (seconds == 0 || seconds > TIMEBASE_CAL_MAX_S)
+		return -1;
+
+	if (timebase_open(device) < 0) {
+		printf("No 1Hz edges on the tick pin\r\n");
+		return -1;
+	}
+
+	printf("Counting the CPU clock for %u seconds\r\n", seconds);
+	// The count is taken against the first edge, so edges missed along
+	// the way cost nothing as long as a later one is latched
+	do {
+		if (timebase_wait_edge() == 0)
+			lost = 0;
+		else if (++lost == TIMEBASE_CAL_RETRIES) {
+			printf("Lost the 1Hz edges\r\n");
+			timebase_close();
+			return -1;
+		}
+		else if (debug)
+			printf("[no edge latched, waiting again]\r\n");
+	} while (tb_edge_sec[tb_head] < seconds);
+	ticks = tb_edge_ticks[tb_head] - tb_first;
+	secs = tb_edge_sec[tb_head];
+
+	timebase_close();
+
+	// Thousandths of a tick a second over the nominal rate, then ppb;
+	// TIMEBASE_CAL_MAX_S keeps both within 32 bits
+	excess = (long)(ticks - secs * PRT_HZ) * 1000 / (long)secs;
+	*ppb = excess * 1000 / (long)(PRT_HZ / 1000);
+
+	return 0;
+}
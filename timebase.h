@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  timebase.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef TIMEBASE_H_
+#define TIMEBASE_H_
+
+// Edges the counter rate is fitted over
+#define TIMEBASE_FIT		8
+
+// Longest wait for a latched edge, centiseconds: long enough to pass an
+// edge that was seen late and rejected, and latch the one after
+#define TIMEBASE_EDGE_TIMEOUT	250
+
+// Seconds -calibrate counts over by default, and at most
+#define TIMEBASE_CAL_S		60
+#define TIMEBASE_CAL_MAX_S	600
+
+// Waits for an edge -calibrate may lose in a row before giving up
+#define TIMEBASE_CAL_RETRIES	3
+
+typedef struct timebase_time {
+	unsigned long	sec;
+	unsigned long	usec;
+} timebase_time;
+
+int timebase_open(char device);
+void timebase_close(void);
+int timebase_poll(void);
+int timebase_wait_edge(void);
+unsigned long timebase_hz(void);
+unsigned char timebase_fitted(void);
+long timebase_residual(void);
+void timebase_mono(timebase_time *t);
+void timebase_wall(timebase_time *t);
+int timebase_show(char device);
+int timebase_calibrate(char device, unsigned int seconds, long *ppb);
+
+#endif // TIMEBASE_H_
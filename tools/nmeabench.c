@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  nmeabench.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Host-side check and benchmark of the NMEA parser against a recording
+ *  of a receiver's output:
+ *
+ *	cc -O2 -I. -o nmeabench tools/nmeabench.c nmea.c
+ *	./nmeabench tools/nmea-sample.txt
+ *
+ *  Every time sentence is checked against the one before: a receiver
+ *  reporting once a second must never go backwards or skip, and RMC and
+ *  ZDA within the same second must agree.  The recording is then parsed
+ *  repeatedly to measure throughput.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "nmea.h"
+
+#define BENCH_MIN_SECS		1.0
+
+static long long days_from_civil(int y, int m, int d)
+{
+	int yoe, doy, doe;
+
+	y -= m <= 2;
+	yoe = y % 400;
+	doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return (long long)(y / 400) * 146097 + doe - 719468;
+}
+
+static long long epoch_ms(const nmea_time *t)
+{
+	long long s = days_from_civil(t->dt.year, t->dt.mon, t->dt.day) * 86400
+		    + t->dt.hour * 3600 + t->dt.min * 60 + t->dt.sec;
+
+	return s * 1000 + t->ms;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	nmea_parser p;
+	nmea_time t;
+	long long prev = -1, cur;
+	long rmc = 0, zda = 0, skips = 0, backs = 0;
+	long passes, i;
+	double start, secs;
+	char *data;
+	long len;
+	int type;
+	FILE *f;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <recording>\n", argv[0]);
+		return 1;
+	}
+
+	f = fopen(argv[1], "rb");
+	if (f == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	rewind(f);
+	data = malloc(len);
+	if (data == NULL || fread(data, 1, len, f) != (size_t)len) {
+		fprintf(stderr, "%s: read failed\n", argv[1]);
+		return 1;
+	}
+	fclose(f);
+
+	// Accuracy
+	nmea_init(&p);
+	for (i = 0; i < len; ++i) {
+		type = nmea_feed(&p, data[i], &t);
+		if (type == NMEA_NONE)
+			continue;
+		if (type == NMEA_RMC)
+			++rmc;
+		else
+			++zda;
+
+		cur = epoch_ms(&t);
+		if (prev >= 0) {
+			if (cur < prev) {
+				++backs;
+				printf("backwards: %04d-%02d-%02dT%02d:%02d:%02d.%03d\n",
+				       t.dt.year, t.dt.mon, t.dt.day, t.dt.hour,
+				       t.dt.min, t.dt.sec, t.ms);
+			}
+			else if (cur - prev > 1000) {
+				++skips;
+				printf("skipped %lld ms before %04d-%02d-%02dT%02d:%02d:%02d\n",
+				       cur - prev - 1000, t.dt.year, t.dt.mon,
+				       t.dt.day, t.dt.hour, t.dt.min, t.dt.sec);
+			}
+		}
+		prev = cur;
+	}
+	printf("%ld RMC, %ld ZDA, %lu bad checksum, %lu invalid, "
+	       "%ld skips, %ld backwards\n", rmc, zda, p.bad_sum,
+	       p.bad_field, skips, backs);
+
+	// Throughput
+	passes = 0;
+	start = now();
+	do {
+		nmea_init(&p);
+		for (i = 0; i < len; ++i)
+			nmea_feed(&p, data[i], &t);
+		++passes;
+		secs = now() - start;
+	} while (secs < BENCH_MIN_SECS);
+
+	printf("%ld passes in %.2f s: %.1f MB/s, %.0f sentences/s, "
+	       "%.1f ns/char\n", passes, secs, passes * len / secs / 1e6,
+	       passes * (double)p.sentences / secs,
+	       secs * 1e9 / ((double)passes * len));
+
+	free(data);
+	return backs != 0 || skips != 0;
+}
@@ -0,0 +1,214 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  tzcomp.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Host-side compiler from a POSIX TZ rule to the compact transition table
+ *  read by hwclock -tz.  Build and run on any host with a C compiler:
+ *
+ *	cc -o tzcomp tools/tzcomp.c
+ *	./tzcomp "GMT0BST,M3.5.0/1,M10.5.0" GB.tzc
+ *
+ *  Table layout, all fields least significant byte first:
+ *
+ *	0	"TZC1"
+ *	4	number of transitions			(2)
+ *	6	offset before the first, minutes	(2, signed)
+ *	8	transitions: UTC Unix seconds (4), then
+ *		offset from then on, minutes (2, signed)
+ *
+ *  Only the Mm.w.d rule form is supported, which covers the zones in use.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define TZ_FIRST_YEAR	2000
+#define TZ_LAST_YEAR	2099
+#define TZ_MAX_TRANS	256
+
+typedef struct rule {
+	int mon, week, wday;
+	long time;		// Seconds after local midnight
+} rule;
+
+typedef struct trans {
+	unsigned long utc;
+	int offset;		// Minutes east of UTC
+} trans;
+
+static const char *parse_name(const char *p)
+{
+	if (*p == '<') {
+		while (*p && *p != '>')
+			++p;
+		return *p ? p + 1 : NULL;
+	}
+	while (isalpha((unsigned char)*p))
+		++p;
+	return p;
+}
+
+// [+-]hh[:mm[:ss]], returning seconds
+static const char *parse_time(const char *p, long *secs)
+{
+	int sign = 1;
+	long h = 0, m = 0, s = 0;
+
+	if (*p == '+' || *p == '-')
+		sign = *p++ == '-' ? -1 : 1;
+	if (!isdigit((unsigned char)*p))
+		return NULL;
+	h = strtol(p, (char **)&p, 10);
+	if (*p == ':') {
+		m = strtol(p + 1, (char **)&p, 10);
+		if (*p == ':')
+			s = strtol(p + 1, (char **)&p, 10);
+	}
+	*secs = sign * (h * 3600 + m * 60 + s);
+	return p;
+}
+
+static const char *parse_rule(const char *p, rule *r)
+{
+	if (*p++ != 'M')
+		return NULL;
+	r->mon = strtol(p, (char **)&p, 10);
+	if (*p++ != '.')
+		return NULL;
+	r->week = strtol(p, (char **)&p, 10);
+	if (*p++ != '.')
+		return NULL;
+	r->wday = strtol(p, (char **)&p, 10);
+	r->time = 7200;
+	if (*p == '/')
+		p = parse_time(p + 1, &r->time);
+	if (p == NULL || r->mon < 1 || r->mon > 12 || r->week < 1 ||
+	    r->week > 5 || r->wday < 0 || r->wday > 6)
+		return NULL;
+	return p;
+}
+
+static long days_from_civil(int y, int m, int d)
+{
+	int yoe, doy, doe;
+
+	y -= m <= 2;
+	yoe = y % 400;
+	doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return (long)(y / 400) * 146097 + doe - 719468;
+}
+
+// Local midnight (as days since the epoch) of the rule's day in year
+static long rule_day(int year, const rule *r)
+{
+	static const int mdays[12] =
+		{ 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	long first = days_from_civil(year, r->mon, 1);
+	int len = mdays[r->mon - 1];
+	int wday1 = (int)((first + 4) % 7);	// 1970-01-01 was a Thursday
+	int d;
+
+	if (r->mon == 2 && (year % 4 == 0 && (year % 100 != 0 ||
+					      year % 400 == 0)))
+		++len;
+
+	d = (r->wday - wday1 + 7) % 7 + (r->week - 1) * 7;
+	while (d >= len)
+		d -= 7;
+	return first + d;
+}
+
+static int cmp_trans(const void *a, const void *b)
+{
+	const trans *x = a, *y = b;
+
+	return x->utc < y->utc ? -1 : x->utc > y->utc;
+}
+
+static void put16(FILE *f, int v)
+{
+	fputc(v & 0xff, f);
+	fputc((v >> 8) & 0xff, f);
+}
+
+static void put32(FILE *f, unsigned long v)
+{
+	put16(f, v & 0xffff);
+	put16(f, (v >> 16) & 0xffff);
+}
+
+int main(int argc, char *argv[])
+{
+	static trans t[TZ_MAX_TRANS];
+	const char *p;
+	long std, dst;
+	rule start, end;
+	int first = TZ_FIRST_YEAR, last = TZ_LAST_YEAR;
+	int n = 0, y, i;
+	FILE *f;
+
+	if (argc != 3 && argc != 5) {
+		fprintf(stderr, "Usage: %s <POSIX TZ> <output> "
+				"[ <first year> <last year> ]\n", argv[0]);
+		return 1;
+	}
+	if (argc == 5) {
+		first = atoi(argv[3]);
+		last = atoi(argv[4]);
+	}
+
+	// std offset [ dst [ offset ] , start , end ]
+	p = parse_name(argv[1]);
+	if (p == NULL || (p = parse_time(p, &std)) == NULL) {
+		fprintf(stderr, "Invalid standard time in '%s'\n", argv[1]);
+		return 1;
+	}
+	std = -std;		// POSIX offsets are west of UTC
+	dst = std + 3600;
+
+	if (*p) {
+		p = parse_name(p);
+		if (p != NULL && *p != ',' && *p) {
+			p = parse_time(p, &dst);
+			dst = -dst;
+		}
+		if (p == NULL || *p++ != ',' ||
+		    (p = parse_rule(p, &start)) == NULL || *p++ != ',' ||
+		    (p = parse_rule(p, &end)) == NULL || *p) {
+			fprintf(stderr, "Invalid DST rule in '%s'\n", argv[1]);
+			return 1;
+		}
+
+		for (y = first; y <= last && n + 2 <= TZ_MAX_TRANS; ++y) {
+			// DST starts at a standard time, and ends at a DST time
+			t[n].utc = rule_day(y, &start) * 86400 + start.time - std;
+			t[n++].offset = dst / 60;
+			t[n].utc = rule_day(y, &end) * 86400 + end.time - dst;
+			t[n++].offset = std / 60;
+		}
+		qsort(t, n, sizeof t[0], cmp_trans);
+	}
+
+	f = fopen(argv[2], "wb");
+	if (f == NULL) {
+		perror(argv[2]);
+		return 1;
+	}
+	fputs("TZC1", f);
+	put16(f, n);
+	// Before the first transition the other offset applies
+	put16(f, n > 0 ? (t[0].offset == std / 60 ? dst : std) / 60 : std / 60);
+	for (i = 0; i < n; ++i) {
+		put32(f, t[i].utc);
+		put16(f, t[i].offset);
+	}
+	fclose(f);
+
+	printf("%d transitions, %d bytes\n", n, 8 + n * 6);
+	return 0;
+}
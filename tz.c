@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  tz.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Local time from a table of precompiled transitions.  The DST rules are
+ *  evaluated once, on the host, so a conversion here is a binary search
+ *  of at most eight comparisons and an addition.
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tz.h"
+#include "mos-interface.h"
+
+extern char debug;
+
+// Transitions read from the file at a time
+#define TZ_CHUNK		16
+
+static unsigned int tz_count;
+static int tz_initial;
+static unsigned long tz_utc[TZ_MAX_TRANS];
+static short tz_off[TZ_MAX_TRANS];
+static char tz_valid;
+
+/*
+ * tz_load - read a compiled table, returning the number of transitions or
+ * -1 if the file is missing or malformed
+ */
+
+int tz_load(const char *file)
+{
+	unsigned char buf[TZ_CHUNK * TZ_ENTRY_LEN];
+	unsigned int i, n, len;
+	unsigned char *p;
+	UINT8 fh;
+
+	tz_valid = 0;
+
+	fh = mos_fopen((char *)file, fa_read | fa_open_existing);
+	if (fh == 0)
+		return -1;
+
+	if (mos_fread(fh, (char *)buf, TZ_HDR_LEN) != TZ_HDR_LEN ||
+	    memcmp(buf, TZ_MAGIC, 4) != 0)
+		goto invalid;
+
+	tz_count = buf[4] | buf[5] << 8;
+	tz_initial = (short)(buf[6] | buf[7] << 8);
+	if (tz_count > TZ_MAX_TRANS)
+		goto invalid;
+
+	for (i = 0; i < tz_count; i += n) {
+		n = tz_count - i < TZ_CHUNK ? tz_count - i : TZ_CHUNK;
+		len = n * TZ_ENTRY_LEN;
+		if (mos_fread(fh, (char *)buf, len) != len)
+			goto invalid;
+		for (p = buf; p < buf + len; p += TZ_ENTRY_LEN) {
+			tz_utc[i + (p - buf) / TZ_ENTRY_LEN] =
+				(unsigned long)p[0] | (unsigned long)p[1] << 8 |
+				(unsigned long)p[2] << 16 |
+				(unsigned long)p[3] << 24;
+			tz_off[i + (p - buf) / TZ_ENTRY_LEN] =
+				(short)(p[4] | p[5] << 8);
+		}
+	}
+	mos_fclose(fh);
+
+	if (debug)
+		printf("[tz %s: %u transitions]\r\n", file, tz_count);
+
+	tz_valid = 1;
+	return tz_count;
+
+invalid:
+	mos_fclose(fh);
+	if (debug)
+		printf("[tz %s invalid]\r\n", file);
+	return -1;
+}
+
+char tz_loaded(void)
+{
+	return tz_valid;
+}
+
+/*
+ * tz_offset - minutes east of UTC in effect at utc, or 0 with no table
+ */
+
+int tz_offset(unsigned long utc)
+{
+	unsigned int lo, hi, mid;
+
+	if (!tz_valid)
+		return 0;
+
+	// Find the number of transitions at or before utc
+	lo = 0;
+	hi = tz_count;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (tz_utc[mid] <= utc)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo == 0 ? tz_initial : tz_off[lo - 1];
+}
+
+unsigned long tz_to_local(unsigned long utc, int *offset)
+{
+	int off = tz_offset(utc);
+
+	if (offset != NULL)
+		*offset = off;
+	return utc + (long)off * 60;
+}
+
+/*
+ * tz_from_local - UTC for a local time.  Transitions are months apart, so
+ * only the offsets a day either side can apply.  A time repeated at the
+ * end of DST is taken as its first occurrence, and one skipped at the
+ * start of DST is read with the offset from before the change.
+ */
+
+unsigned long tz_from_local(unsigned long local, int *offset)
+{
+	int before = tz_offset(local - 86400UL);
+	int after = tz_offset(local + 86400UL);
+	int off = before;
+
+	if (tz_offset(local - (long)before * 60) != before &&
+	    tz_offset(local - (long)after * 60) == after)
+		off = after;
+
+	if (offset != NULL)
+		*offset = off;
+	return local - (long)off * 60;
+}
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  tz.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef TZ_H_
+#define TZ_H_
+
+/*
+ * Compiled time-zone table, as written by tools/tzcomp.c.  All fields are
+ * least significant byte first:
+ *
+ *	"TZC1", transitions (2), initial offset (2), transitions
+ *
+ * where each transition is the UTC epoch second it takes effect (4) and
+ * the offset from UTC from then on, in minutes (2, signed).
+ */
+#define TZ_MAGIC		"TZC1"
+#define TZ_HDR_LEN		8
+#define TZ_ENTRY_LEN		6
+#define TZ_MAX_TRANS		256
+
+// Directory searched for a table named by the tz setting
+#define TZ_DIR			"/mos/tz/"
+#define TZ_EXT			".tzc"
+
+int tz_load(const char *file);
+char tz_loaded(void);
+int tz_offset(unsigned long utc);
+unsigned long tz_to_local(unsigned long utc, int *offset);
+unsigned long tz_from_local(unsigned long local, int *offset);
+
+#endif // TZ_H_
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  uart.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Polled driver for the eZ80 UART1.  MOS's own UART1 API blocks in
+ *  mos_ugetc until a character arrives, which does not suit code that
+ *  must also watch the clock, so the registers are driven directly, as
+ *  they are for I2C.
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+
+#include "uart.h"
+
+extern char debug;
+
+static unsigned int overruns;
+
+/*
+ * uart_open - claim the UART1 pins, and set the baud rate and 8N1 framing
+ */
+
+int uart_open(unsigned long baud)
+{
+	unsigned int brg;
+
+	if (baud == 0)
+		return -1;
+	brg = (UART_CLOCK + baud * 8) / (baud * 16);
+	if (brg == 0 || brg > 0xffff)
+		return -1;
+
+	// GPIO mode 7: alternate function
+	PC_DDR  |= UART1_PINS;
+	PC_ALT1 &= ~UART1_PINS;
+	PC_ALT2 |= UART1_PINS;
+
+	UART1_IER = 0;
+	UART1_LCTL = UART_LCTL_DLAB;
+	UART1_BRG_L = brg & 0xff;
+	UART1_BRG_H = brg >> 8;
+	UART1_LCTL = UART_LCTL_8N1;
+	UART1_FCTL = UART_FCTL_INIT;
+	UART1_MCTL = 0;
+
+	overruns = 0;
+	if (debug)
+		printf("[uart1 %lu baud, brg %u]\r\n", baud, brg);
+
+	return 0;
+}
+
+// Return the pins to GPIO inputs
+void uart_close(void)
+{
+	PC_DDR  |= UART1_PINS;
+	PC_ALT1 &= ~UART1_PINS;
+	PC_ALT2 &= ~UART1_PINS;
+}
+
+/*
+ * uart_getc - the next received character, or -1 if there is none
+ */
+
+int uart_getc(void)
+{
+	unsigned char lsr = UART1_LSR;
+
+	if (lsr & UART_LSR_OE)
+		++overruns;
+	if (!(lsr & UART_LSR_DR))
+		return -1;
+
+	return UART1_RBR;
+}
+
+void uart_putc(unsigned char c)
+{
+	while (!(UART1_LSR & UART_LSR_THRE))
+		;
+	UART1_THR = c;
+}
+
+void uart_write(const unsigned char *buf, unsigned int len)
+{
+	while (len-- > 0)
+		uart_putc(*buf++);
+}
+
+unsigned int uart_overruns(void)
+{
+	return overruns;
+}
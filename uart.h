@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  uart.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef UART_H_
+#define UART_H_
+
+// Line status register
+#define UART_LSR_DR		0x01	// Receive data ready
+#define UART_LSR_OE		0x02	// Overrun
+#define UART_LSR_THRE		0x20	// Transmit holding register empty
+
+// Line control register
+#define UART_LCTL_DLAB		0x80	// Divisor latch access
+#define UART_LCTL_8N1		0x03
+
+// FIFO control register: enable, and clear both FIFOs
+#define UART_FCTL_INIT		0x07
+
+// UART1 is on Port C pins 0 (TxD) and 1 (RxD)
+#define UART1_PINS		0x03
+
+// Input clock of the baud rate generator, as for I2C
+#define UART_CLOCK		18432000UL
+
+int uart_open(unsigned long baud);
+void uart_close(void);
+int uart_getc(void);
+void uart_putc(unsigned char c);
+void uart_write(const unsigned char *buf, unsigned int len);
+unsigned int uart_overruns(void);
+
+#endif // UART_H_
@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  watch.c
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ *
+ *  Continuously display the hardware clock, redrawing only the characters
+ *  that change each second.
+ */
+
+#include <ez80.h>
+#include <stdio.h>
+
+#include "rtc.h"
+#include "tick.h"
+#include "watch.h"
+#include "mos-interface.h"
+
+// Ask the VDP where the text cursor is, returning the row or -1
+static int watch_cursor_row(void)
+{
+	const char vdp_cursor[3] = { 23, 0, VDP_cursor };
+	struct mos_sysvars *sysvars = mos_sysvars();
+	unsigned long start;
+
+	sysvars->vdp_protocol_flags &= ~VDPP_FLAG_CURSOR;
+	mos_write(vdp_cursor, sizeof vdp_cursor);
+
+	start = sysvars->clock;
+	while (!(sysvars->vdp_protocol_flags & VDPP_FLAG_CURSOR))
+		if (sysvars->clock - start > SYSRTC_TIMEOUT_CS)
+			return -1;
+
+	return sysvars->cursorY;
+}
+
+static void watch_goto(int x, int y)
+{
+	putch(31);
+	putch(x);
+	putch(y);
+}
+
+// Send only the runs of characters that differ between old and new
+static void watch_redraw(char *old, const char *new, int row)
+{
+	int i, j, end;
+
+	i = 0;
+	while (i < ISO8601_DT_LEN) {
+		if (old[i] == new[i]) {
+			++i;
+			continue;
+		}
+
+		// Extend the run over small gaps of unchanged characters
+		end = i + 1;
+		for (j = end; j < ISO8601_DT_LEN && j - end <= WATCH_MAX_GAP; ++j)
+			if (old[j] != new[j])
+				end = j + 1;
+
+		watch_goto(i, row);
+		for (j = i; j < end; ++j) {
+			putch(new[j]);
+			old[j] = new[j];
+		}
+		i = end;
+	}
+}
+
+static int watch_read(char device, char *buf)
+{
+	iso8601_datetime dt;
+
+	if ((device == 1 ? read_modrtc(&dt) : read_modrtc2(&dt)) == -1)
+		return -1;
+
+	return iso8601_to_str(&dt, buf, ISO8601_DT_LEN + 1);
+}
+
+/*
+ * watch - show the hardware clock until a key is pressed
+ */
+
+int watch(char device)
+{
+	struct mos_sysvars *sysvars = mos_sysvars();
+	char shown[ISO8601_DT_LEN + 1], now[ISO8601_DT_LEN + 1];
+	int row;
+
+	if (tick_open(device) < 0 || watch_read(device, shown) < 0) {
+		printf("Unable to read date and time from MOD-RTC\r\n");
+		return -1;
+	}
+
+	putch('\r');
+	row = watch_cursor_row();
+	if (row < 0) {
+		printf("Unable to read cursor position\r\n");
+		tick_close();
+		return -1;
+	}
+	printf("%s", shown);
+
+	sysvars->keyascii = 0;
+	while (sysvars->keyascii == 0) {
+		if (tick_wait() < 0 || watch_read(device, now) < 0)
+			break;
+		watch_redraw(shown, now, row);
+	}
+	sysvars->keyascii = 0;
+
+	tick_close();
+	watch_goto(ISO8601_DT_LEN, row);
+	printf("\r\n");
+
+	return 0;
+}
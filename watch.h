@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  watch.h
+ *
+ *  Copyright (C) 2023  Leigh Brown
+ */
+
+#ifndef WATCH_H_
+#define WATCH_H_
+
+// Unchanged characters between two changes that are cheaper to resend
+// than another VDU 31 cursor move (3 bytes)
+#define WATCH_MAX_GAP		2
+
+int watch(char device);
+
+#endif // WATCH_H_